@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <cmath>
+#include "am_demod.h"
+#include "fm_demod.h"
+
+#define AM_DEFAULT_SAMPLE_RATE 24000.0f
+#define AM_CHUNK 64                 // Carrier and gain update interval
+#define AM_DC_BLOCK_HZ 20.0f        // Carrier removal corner
+#define AM_AGC_TARGET 0.5f          // Output peak at 100% modulation
+#define AM_AGC_MAX_GAIN 1000.0f     // 60 dB, keeps an empty channel from being pumped up to full level
+#define AM_PLL_LOOP_HZ 50.0f        // PLL natural frequency
+#define AM_PLL_PULL_HZ 1000.0f      // Carrier offset the PLL will follow
+#define AM_PLL_LOCK_RATIO 0.9f      // In-phase share of the magnitude when locked
+
+AmDetector am_detector_parse(const std::string &name) {
+    if (name == "sync") return AmDetector::SYNC;
+    return AmDetector::ENVELOPE;
+}
+
+const char *am_detector_name(AmDetector detector) {
+    return (detector == AmDetector::SYNC) ? "sync" : "envelope";
+}
+
+AMDemodulator::AMDemodulator() :
+    detector(AmDetector::ENVELOPE),
+    sample_rate(AM_DEFAULT_SAMPLE_RATE),
+    phase(0.0f),
+    freq(0.0f),
+    freq_limit(0.0f),
+    kp(0.0f),
+    ki(0.0f),
+    locked(false),
+    agc_enabled(true),
+    primed(false),
+    dc_alpha(0.0f),
+    attack_alpha(0.0f),
+    release_alpha(0.0f),
+    carrier(0.0f),
+    carrier_level(0.0f),
+    gain(1.0f) {
+    configure(AmDetector::ENVELOPE, sample_rate, true, 10.0f, 500.0f);
+}
+
+void AMDemodulator::configure(AmDetector det, float sampleRate, bool agc, float attack_ms, float release_ms) {
+    detector = det;
+    sample_rate = sampleRate;
+    agc_enabled = agc;
+
+    // Second order loop with a damping of 0.707, gains in rad/sample
+    float wn = 2.0f * static_cast<float>(M_PI) * AM_PLL_LOOP_HZ / sample_rate;
+    kp = 2.0f * 0.707f * wn;
+    ki = wn * wn;
+    freq_limit = 2.0f * static_cast<float>(M_PI) * AM_PLL_PULL_HZ / sample_rate;
+
+    // Time constants per chunk
+    float chunk_seconds = AM_CHUNK / sample_rate;
+    dc_alpha = 1.0f - expf(-2.0f * static_cast<float>(M_PI) * AM_DC_BLOCK_HZ * chunk_seconds);
+    attack_alpha = 1.0f - expf(-chunk_seconds / std::max(attack_ms * 1e-3f, chunk_seconds));
+    release_alpha = 1.0f - expf(-chunk_seconds / std::max(release_ms * 1e-3f, chunk_seconds));
+    reset();
+}
+
+void AMDemodulator::reset() {
+    phase = 0.0f;
+    freq = 0.0f;
+    locked = false;
+    primed = false;
+    carrier = 0.0f;
+    carrier_level = 0.0f;
+    gain = 1.0f;
+}
+
+float AMDemodulator::gainDb() const {
+    return 20.0f * log10f(gain);
+}
+
+void AMDemodulator::demodulate(const std::complex<float> *in, float *out, size_t count) {
+    if (detector == AmDetector::SYNC) {
+        detectSync(in, out, count);
+    } else {
+        detectEnvelope(in, out, count);
+    }
+    level(out, count);
+}
+
+void AMDemodulator::detectEnvelope(const std::complex<float> *in, float *out, size_t count) {
+    // Plain loop over the interleaved floats, no std::abs() overflow
+    // guards, so it vectorizes
+    const float *x = reinterpret_cast<const float *>(in);
+    for (size_t i = 0; i < count; i++) {
+        out[i] = std::sqrt(x[2 * i] * x[2 * i] + x[2 * i + 1] * x[2 * i + 1]);
+    }
+}
+
+void AMDemodulator::detectSync(const std::complex<float> *in, float *out, size_t count) {
+    const float pi = static_cast<float>(M_PI);
+    float p = phase;
+    float f = freq;
+    double in_phase = 0.0;
+    double magnitude = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        // Rotate the carrier onto the real axis
+        float c = cosf(p);
+        float s = sinf(p);
+        float re = in[i].real() * c + in[i].imag() * s;
+        float im = in[i].imag() * c - in[i].real() * s;
+        out[i] = re;
+        in_phase += re;
+        magnitude += std::sqrt(re * re + im * im);
+
+        // The phase error does not depend on the signal level, so the
+        // loop bandwidth stays put as the carrier fades
+        float error = fast_atan2(im, re);
+        f = std::min(freq_limit, std::max(-freq_limit, f + ki * error));
+        p += f + kp * error;
+        if (p > pi) {
+            p -= 2.0f * pi;
+        } else if (p < -pi) {
+            p += 2.0f * pi;
+        }
+    }
+    phase = p;
+    freq = f;
+    if (count > 0) {
+        locked = in_phase > AM_PLL_LOCK_RATIO * magnitude;
+    }
+}
+
+void AMDemodulator::level(float *x, size_t count) {
+    for (size_t base = 0; base < count; base += AM_CHUNK) {
+        size_t n = std::min<size_t>(AM_CHUNK, count - base);
+        float *y = x + base;
+        float sum = 0.0f;
+        for (size_t k = 0; k < n; k++) {
+            sum += y[k];
+        }
+        float mean = sum / n;
+        float weight = n / static_cast<float>(AM_CHUNK);
+        if (!primed) {
+            // Start from the carrier at hand rather than ramping up from 0
+            carrier = mean;
+            carrier_level = mean;
+            primed = true;
+        } else {
+            carrier += dc_alpha * weight * (mean - carrier);
+            float alpha = (mean > carrier_level) ? attack_alpha : release_alpha;
+            carrier_level += alpha * weight * (mean - carrier_level);
+        }
+
+        // Gain ramps across the chunk, so its steps do not click
+        float next_gain = 1.0f;
+        if (agc_enabled) {
+            next_gain = AM_AGC_TARGET / std::max(carrier_level, AM_AGC_TARGET / AM_AGC_MAX_GAIN);
+        }
+        float g = gain;
+        float step = (next_gain - gain) / n;
+        float c = carrier;
+        for (size_t k = 0; k < n; k++) {
+            y[k] = (y[k] - c) * (g + step * k);
+        }
+        gain = next_gain;
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef _AM_DEMOD_H
+#define _AM_DEMOD_H
+
+#include <complex>
+#include <cstddef>
+#include <string>
+
+// Detector used by the AM demodulator
+enum class AmDetector {
+    ENVELOPE,  // Magnitude of the channel, no carrier tracking
+    SYNC       // PLL on the carrier, in-phase product; holds up better in selective fading
+};
+
+AmDetector am_detector_parse(const std::string &name);
+const char *am_detector_name(AmDetector detector);
+
+// AM demodulator for the decimated channel. The detector output has the
+// carrier (DC) removed and is leveled by an AGC that follows the carrier
+// with a fast attack and a slow release, so 100% modulation comes out at
+// the same level on strong and weak stations.
+class AMDemodulator {
+    public:
+        AMDemodulator();
+
+        void configure(AmDetector detector, float sampleRate, bool agc, float attack_ms, float release_ms);
+        AmDetector getDetector() const { return detector; }
+        void reset();
+
+        // Demodulate a block of 'count' samples; 'out' may not alias 'in'
+        void demodulate(const std::complex<float> *in, float *out, size_t count);
+
+        // Carrier PLL locked over the last block, sync detector only
+        bool carrierLocked() const { return locked; }
+        float gainDb() const;
+
+    private:
+        void detectEnvelope(const std::complex<float> *in, float *out, size_t count);
+        void detectSync(const std::complex<float> *in, float *out, size_t count);
+        // Carrier removal and AGC, in place
+        void level(float *x, size_t count);
+
+        AmDetector detector;
+        float sample_rate;
+
+        // Carrier PLL
+        float phase;
+        float freq;               // rad/sample
+        float freq_limit;
+        float kp;                 // Proportional and integral loop gains
+        float ki;
+        bool locked;
+
+        // Carrier removal and AGC, updated once per chunk
+        bool agc_enabled;
+        bool primed;              // Carrier and level estimates valid
+        float dc_alpha;
+        float attack_alpha;
+        float release_alpha;
+        float carrier;
+        float carrier_level;      // Followed by the AGC
+        float gain;
+};
+
+#endif // _AM_DEMOD_H
@@ -0,0 +1,277 @@
+#include <iostream>
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <shout/shout.h>
+#include "audio_encoder.h"
+
+#define OPUS_RATE 48000              // Ogg granule positions always count 48 kHz samples
+#define OPUS_MAX_PACKET 4000         // Recommended opus_encode() buffer size
+#define OPUS_PACKET_HEADROOM 3       // VBR packets may be this many times the average
+#define OGG_PAGE_OVERHEAD (27 + 255) // Page header with a full lacing table
+
+const std::vector<unsigned char> AudioEncoder::no_header;
+
+AudioEncoder *new_audio_encoder(const Config &config, const AudioProfile &profile) {
+    if (config.icecast_format == "mp3") {
+        return new LameEncoder(config, profile);
+    }
+#ifdef HAVE_OPUS
+    if (config.icecast_format == "opus" || config.icecast_format == "ogg") {
+        return new OpusOggEncoder(config, profile);
+    }
+#endif
+    return nullptr;
+}
+
+LameEncoder::LameEncoder(const Config &config, const AudioProfile &profile) :
+    sample_rate(profile.audio_rate),
+    channels(profile.channels),
+    bitrate(profile.mp3_bitrate),
+    quality(config.mp3_quality),
+    lame(nullptr),
+    have_silence(false),
+    idle(false)
+{
+}
+
+LameEncoder::~LameEncoder() {
+    if (lame) {
+        lame_close(lame);
+    }
+}
+
+bool LameEncoder::open() {
+    lame = lame_init();
+    if (!lame) {
+        std::cerr << "Failed to initialize LAME\n";
+        return false;
+    }
+    lame_set_in_samplerate(lame, sample_rate);
+    lame_set_out_samplerate(lame, sample_rate);
+    lame_set_num_channels(lame, channels);
+    lame_set_mode(lame, channels == 2 ? JOINT_STEREO : MONO);
+    lame_set_quality(lame, quality);
+    lame_set_brate(lame, bitrate);
+    lame_set_VBR(lame, vbr_off);
+    // Frames must not borrow bits from earlier ones, so cached silent
+    // frames can be spliced in while the squelch is closed
+    lame_set_disable_reservoir(lame, 1);
+    if (lame_init_params(lame) < 0) {
+        std::cerr << "Failed to initialize LAME\n";
+        return false;
+    }
+
+    // Silent frames streamed instead of encoding chunks the squelch muted
+    have_silence = silence.build(sample_rate, bitrate, channels);
+    if (!have_silence) {
+        std::cerr << "Could not pre-encode silent MP3 frames, encoding silence instead\n";
+    }
+    return true;
+}
+
+unsigned int LameEncoder::shout_format() const {
+    return SHOUT_FORMAT_MP3;
+}
+
+// LAME's documented worst case for encoding, which also covers a flush,
+// plus the cached frames for the same stretch of silence
+size_t LameEncoder::max_bytes(size_t samples) const {
+    return samples * 5 / 4 + 7200 + samples * bitrate * 125 / sample_rate + 1441;
+}
+
+int LameEncoder::encode(const short *pcm, size_t count, unsigned char *out, size_t out_size) {
+    idle = false;
+    if (channels == 2) {
+        return lame_encode_buffer_interleaved(lame, const_cast<short *>(pcm), static_cast<int>(count),
+                                              out, static_cast<int>(out_size));
+    }
+    return lame_encode_buffer(lame, pcm, nullptr, static_cast<int>(count), out, static_cast<int>(out_size));
+}
+
+// Flush what LAME still holds when the squelch closes, then send cached frames
+int LameEncoder::encode_silence(size_t count, unsigned char *out, size_t out_size) {
+    int size = 0;
+    if (!idle) {
+        size = std::max(lame_encode_flush_nogap(lame, out, static_cast<int>(out_size)), 0);
+        idle = true;
+    }
+    return size + static_cast<int>(silence.encode(count, out + size, out_size - size));
+}
+
+#ifdef HAVE_OPUS
+static void put_le16(std::vector<unsigned char> &v, uint16_t x) {
+    v.push_back(x & 0xFF);
+    v.push_back(x >> 8);
+}
+
+static void put_le32(std::vector<unsigned char> &v, uint32_t x) {
+    put_le16(v, x & 0xFFFF);
+    put_le16(v, x >> 16);
+}
+
+OpusOggEncoder::OpusOggEncoder(const Config &config, const AudioProfile &profile) :
+    sample_rate(profile.audio_rate),
+    channels(profile.channels),
+    bitrate(profile.opus_bitrate),
+    complexity(config.opus_complexity),
+    frame_ms(config.opus_frame_ms),
+    frame_size(0),
+    packet_limit(0),
+    opus(nullptr),
+    ogg_ready(false),
+    granule(0),
+    packet_number(0)
+{
+}
+
+OpusOggEncoder::~OpusOggEncoder() {
+    if (opus) {
+        opus_encoder_destroy(opus);
+    }
+    if (ogg_ready) {
+        ogg_stream_clear(&ogg);
+    }
+}
+
+bool OpusOggEncoder::open() {
+    if (sample_rate != 8000 && sample_rate != 12000 && sample_rate != 16000 &&
+        sample_rate != 24000 && sample_rate != 48000) {
+        std::cerr << "Opus needs audio_rate 8000, 12000, 16000, 24000 or 48000, not " << sample_rate << "\n";
+        return false;
+    }
+    if (frame_ms != 5 && frame_ms != 10 && frame_ms != 20 && frame_ms != 40 && frame_ms != 60) {
+        std::cerr << "opus_frame_ms must be 5, 10, 20, 40 or 60, not " << frame_ms << "\n";
+        return false;
+    }
+    frame_size = frame_samples();
+
+    int err = OPUS_OK;
+    opus = opus_encoder_create(sample_rate, channels, OPUS_APPLICATION_AUDIO, &err);
+    if (err != OPUS_OK || !opus) {
+        std::cerr << "Failed to initialize Opus: " << opus_strerror(err) << "\n";
+        opus = nullptr;
+        return false;
+    }
+    opus_encoder_ctl(opus, OPUS_SET_BITRATE(bitrate * 1000));
+    opus_encoder_ctl(opus, OPUS_SET_VBR_CONSTRAINT(1));
+    opus_encoder_ctl(opus, OPUS_SET_COMPLEXITY(complexity));
+    opus_int32 lookahead = 0;
+    opus_encoder_ctl(opus, OPUS_GET_LOOKAHEAD(&lookahead));
+
+    // Constrained VBR stays close to the bitrate, the cap keeps a single
+    // packet from outgrowing the queue frames
+    size_t average = static_cast<size_t>(bitrate) * 125 * frame_ms / 1000;
+    packet_limit = std::min<size_t>(OPUS_MAX_PACKET, std::max<size_t>(average * OPUS_PACKET_HEADROOM, 128));
+    packet.resize(packet_limit);
+    pending.reserve(frame_size * channels);
+
+    ogg_stream_init(&ogg, static_cast<int>(std::chrono::system_clock::now().time_since_epoch().count()));
+    ogg_ready = true;
+
+    // Identification and comment headers, RFC 7845, each on a page of its own
+    std::vector<unsigned char> head(reinterpret_cast<const unsigned char *>("OpusHead"),
+                                    reinterpret_cast<const unsigned char *>("OpusHead") + 8);
+    head.push_back(1);                                   // Version
+    head.push_back(channels);                            // Channel count
+    put_le16(head, static_cast<uint16_t>(lookahead * (OPUS_RATE / sample_rate)));  // Pre-skip
+    put_le32(head, sample_rate);
+    put_le16(head, 0);                                   // Output gain
+    head.push_back(0);                                   // Channel mapping family
+    add_packet(head.data(), head.size(), true, 0);
+    append_pages(header);
+
+    // Comment header with the library version as vendor, no tags
+    const char *vendor = opus_get_version_string();
+    std::vector<unsigned char> tags(reinterpret_cast<const unsigned char *>("OpusTags"),
+                                    reinterpret_cast<const unsigned char *>("OpusTags") + 8);
+    put_le32(tags, strlen(vendor));
+    tags.insert(tags.end(), vendor, vendor + strlen(vendor));
+    put_le32(tags, 0);
+    add_packet(tags.data(), tags.size(), false, 0);
+    append_pages(header);
+
+    printf("Opus: %d kbps %s, %d ms frames, complexity %d\n",
+           bitrate, channels == 2 ? "stereo" : "mono", frame_ms, complexity);
+    return true;
+}
+
+unsigned int OpusOggEncoder::shout_format() const {
+    return SHOUT_FORMAT_OGG;
+}
+
+size_t OpusOggEncoder::max_bytes(size_t samples) const {
+    size_t packets = samples / frame_samples() + 1;
+    return packets * (packet_limit + OGG_PAGE_OVERHEAD);
+}
+
+void OpusOggEncoder::add_packet(const unsigned char *data, size_t size, bool bos, int64_t granulepos) {
+    ogg_packet op;
+    op.packet = const_cast<unsigned char *>(data);
+    op.bytes = static_cast<long>(size);
+    op.b_o_s = bos ? 1 : 0;
+    op.e_o_s = 0;
+    op.granulepos = granulepos;
+    op.packetno = packet_number++;
+    ogg_stream_packetin(&ogg, &op);
+}
+
+void OpusOggEncoder::append_pages(std::vector<unsigned char> &out) {
+    ogg_page page;
+    while (ogg_stream_flush(&ogg, &page)) {
+        out.insert(out.end(), page.header, page.header + page.header_len);
+        out.insert(out.end(), page.body, page.body + page.body_len);
+    }
+}
+
+int OpusOggEncoder::flush_pages(unsigned char *out, size_t out_size) {
+    size_t written = 0;
+    ogg_page page;
+    while (ogg_stream_flush(&ogg, &page)) {
+        size_t size = page.header_len + page.body_len;
+        if (written + size > out_size) {
+            std::cerr << "Opus output does not fit the MP3 queue frame\n";
+            return -1;
+        }
+        memcpy(out + written, page.header, page.header_len);
+        memcpy(out + written + page.header_len, page.body, page.body_len);
+        written += size;
+    }
+    return static_cast<int>(written);
+}
+
+int OpusOggEncoder::encode(const short *pcm, size_t count, unsigned char *out, size_t out_size) {
+    // Interleaved samples from here on
+    size_t frame_len = frame_size * channels;
+    count *= channels;
+    while (count > 0) {
+        // Whole frames straight from the chunk, a partial one is kept
+        const short *frame_pcm = pcm;
+        if (pending.empty() && count >= frame_len) {
+            pcm += frame_len;
+            count -= frame_len;
+        } else {
+            size_t take = std::min(frame_len - pending.size(), count);
+            pending.insert(pending.end(), pcm, pcm + take);
+            pcm += take;
+            count -= take;
+            if (pending.size() < frame_len) {
+                break;
+            }
+            frame_pcm = pending.data();
+        }
+
+        opus_int32 size = opus_encode(opus, frame_pcm, static_cast<int>(frame_size),
+                                      packet.data(), static_cast<opus_int32>(packet.size()));
+        pending.clear();
+        if (size < 0) {
+            std::cerr << "Opus encoding failed: " << opus_strerror(size) << "\n";
+            return -1;
+        }
+        granule += frame_size * (OPUS_RATE / sample_rate);
+        add_packet(packet.data(), size, false, granule);
+    }
+    return flush_pages(out, out_size);
+}
+#endif
@@ -0,0 +1,131 @@
+#ifndef _AUDIO_ENCODER_H
+#define _AUDIO_ENCODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <lame/lame.h>
+#ifdef HAVE_OPUS
+#include <opus/opus.h>
+#include <ogg/ogg.h>
+#endif
+#include "config.h"
+#include "mp3_silence.h"
+
+// Compresses one channel's audio, mono or interleaved stereo, into the
+// byte stream sent to Icecast. The encoder thread hands it whole chunks;
+// a codec may hold samples back until it has a full frame. Sample counts
+// are per channel.
+class AudioEncoder {
+    public:
+        virtual ~AudioEncoder() {}
+        virtual const char *name() const = 0;
+
+        // Set up the codec; false with a message on error
+        virtual bool open() = 0;
+
+        // libshout SHOUT_FORMAT_* of the stream
+        virtual unsigned int shout_format() const = 0;
+        // Nominal bitrate, for pacing and delay estimates
+        virtual int bitrate_kbps() const = 0;
+        // Samples per codec frame, the smallest sensible chunk
+        virtual size_t frame_samples() const = 0;
+        // Largest output of one encode() or encode_silence() call, once open
+        virtual size_t max_bytes(size_t samples) const = 0;
+        // Bytes every new Icecast connection has to start with
+        virtual const std::vector<unsigned char> &stream_header() const { return no_header; }
+
+        // Encode 'count' samples per channel; returns the bytes written or -1
+        virtual int encode(const short *pcm, size_t count, unsigned char *out, size_t out_size) = 0;
+        // Stream 'count' samples of silence while the squelch is closed,
+        // cheaper than encoding zeros. Only called if has_silence().
+        virtual bool has_silence() const { return false; }
+        virtual int encode_silence(size_t, unsigned char *, size_t) { return -1; }
+
+    private:
+        static const std::vector<unsigned char> no_header;
+};
+
+// MP3 through LAME, constant bitrate and without the bit reservoir so
+// cached silent frames can be spliced in while the squelch is closed
+class LameEncoder : public AudioEncoder {
+    public:
+        LameEncoder(const Config &config, const AudioProfile &profile);
+        ~LameEncoder();
+        const char *name() const { return "mp3"; }
+
+        bool open();
+        unsigned int shout_format() const;
+        int bitrate_kbps() const { return bitrate; }
+        size_t frame_samples() const { return sample_rate >= 32000 ? 1152 : 576; }
+        size_t max_bytes(size_t samples) const;
+
+        int encode(const short *pcm, size_t count, unsigned char *out, size_t out_size);
+        bool has_silence() const { return have_silence; }
+        int encode_silence(size_t count, unsigned char *out, size_t out_size);
+
+    private:
+        LameEncoder(const LameEncoder &);
+        LameEncoder &operator=(const LameEncoder &);
+
+        int sample_rate;
+        int channels;
+        int bitrate;
+        int quality;
+        lame_t lame;
+        Mp3Silence silence;
+        bool have_silence;
+        bool idle;        // LAME flushed, silent frames being sent
+};
+
+#ifdef HAVE_OPUS
+// Opus in an Ogg stream. Each chunk is cut into opus_frame_ms frames and
+// the pages are flushed at the end of the chunk, so nothing waits in the
+// muxer. The identification and comment pages are kept for every new
+// Icecast connection.
+class OpusOggEncoder : public AudioEncoder {
+    public:
+        OpusOggEncoder(const Config &config, const AudioProfile &profile);
+        ~OpusOggEncoder();
+        const char *name() const { return "opus"; }
+
+        bool open();
+        unsigned int shout_format() const;
+        int bitrate_kbps() const { return bitrate; }
+        size_t frame_samples() const { return static_cast<size_t>(sample_rate) * frame_ms / 1000; }
+        size_t max_bytes(size_t samples) const;
+        const std::vector<unsigned char> &stream_header() const { return header; }
+
+        int encode(const short *pcm, size_t count, unsigned char *out, size_t out_size);
+
+    private:
+        OpusOggEncoder(const OpusOggEncoder &);
+        OpusOggEncoder &operator=(const OpusOggEncoder &);
+
+        void add_packet(const unsigned char *data, size_t size, bool bos, int64_t granulepos);
+        int flush_pages(unsigned char *out, size_t out_size);
+        void append_pages(std::vector<unsigned char> &out);
+
+        int sample_rate;
+        int channels;
+        int bitrate;
+        int complexity;
+        int frame_ms;
+        size_t frame_size;           // Samples per Opus frame at sample_rate
+        size_t packet_limit;         // Caps VBR packets, bounds max_bytes()
+        OpusEncoder *opus;
+        ogg_stream_state ogg;
+        bool ogg_ready;
+        int64_t granule;             // Always counted at 48 kHz
+        int64_t packet_number;
+        std::vector<short> pending;  // Start of a frame left over from the last chunk, interleaved
+        std::vector<unsigned char> packet;
+        std::vector<unsigned char> header;
+};
+#endif
+
+// Encoder for config.icecast_format at the profile's rate and bitrate,
+// not opened yet; nullptr if the format is unknown or not built in
+AudioEncoder *new_audio_encoder(const Config &config, const AudioProfile &profile);
+
+#endif // _AUDIO_ENCODER_H
@@ -21,7 +21,7 @@ done
 echo "=== System Information ==="
 gcc --version
 make --version
-pkg-config --list-all | grep -E 'rtlsdr|shout|lame|liquid|fftw3'
+pkg-config --list-all | grep -E 'rtlsdr|shout|lame|liquid|fftw3|opus|ogg'
 
 echo "=== Building Project ==="
 make VERBOSE=1
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <cmath>
+#include "channelizer.h"
+
+#define HALFBAND_SEMI_LENGTH 8       // Halfband filter length is 4*m+1
+#define CHANNEL_STOPBAND_DB 60.0f
+#define CHANNEL_MAX_CUTOFF 0.4f      // Max cutoff relative to the output rate
+
+Channelizer::Channelizer(int input_rate, int min_output_rate, float cutoff) :
+    final_stage(nullptr),
+    final_decim(1),
+    final_len(0),
+    final_fill(0),
+    total_decim(1),
+    out_rate(input_rate),
+    cutoff_hz(cutoff),
+    gain(1.0f)
+{
+    // Halfband stages while the rate stays above the minimum
+    double rate = input_rate;
+    while (rate / 2.0 >= min_output_rate) {
+        halfbands.push_back(resamp2_crcf_create(HALFBAND_SEMI_LENGTH, 0.0f, CHANNEL_STOPBAND_DB));
+        rate /= 2.0;
+        total_decim *= 2;
+    }
+    hb_carry.assign(halfbands.size(), std::complex<float>(0.0f, 0.0f));
+    hb_has_carry.assign(halfbands.size(), false);
+
+    // Remaining integer step in the polyphase FIR
+    final_decim = std::max(1, static_cast<int>(rate / min_output_rate));
+    out_rate = rate / final_decim;
+    total_decim *= final_decim;
+
+    // Channel filter, designed at the rate feeding the final stage
+    cutoff_hz = std::min(cutoff_hz, static_cast<float>(CHANNEL_MAX_CUTOFF * out_rate));
+    float fc = cutoff_hz / rate;
+    float transition = (0.5f * out_rate - cutoff_hz) / rate;
+    final_len = estimate_req_filter_len(transition, CHANNEL_STOPBAND_DB);
+    final_len = std::max(final_len, 2 * final_decim + 1) | 1;
+
+    std::vector<float> taps(final_len);
+    liquid_firdes_kaiser(final_len, fc, CHANNEL_STOPBAND_DB, 0.0f, taps.data());
+    float sum = 0.0f;
+    for (unsigned int i = 0; i < final_len; i++) sum += taps[i];
+    for (unsigned int i = 0; i < final_len; i++) taps[i] /= sum;
+
+    final_stage = firdecim_crcf_create(final_decim, taps.data(), final_len);
+    final_buf.assign(final_decim, std::complex<float>(0.0f, 0.0f));
+
+    // Measure the DC gain of the whole cascade and normalize it away
+    std::vector<std::complex<float>> probe(total_decim * 256, std::complex<float>(1.0f, 0.0f));
+    std::vector<std::complex<float>> response(probe.size());
+    size_t n = execute(probe.data(), probe.size(), response.data());
+    if (n > 0 && std::abs(response[n - 1]) > 0.0f) {
+        gain = 1.0f / std::abs(response[n - 1]);
+    }
+    reset();
+}
+
+Channelizer::~Channelizer() {
+    for (size_t i = 0; i < halfbands.size(); i++) {
+        resamp2_crcf_destroy(halfbands[i]);
+    }
+    if (final_stage) {
+        firdecim_crcf_destroy(final_stage);
+    }
+}
+
+void Channelizer::reset() {
+    for (size_t i = 0; i < halfbands.size(); i++) {
+        resamp2_crcf_reset(halfbands[i]);
+        hb_has_carry[i] = false;
+    }
+    firdecim_crcf_reset(final_stage);
+    final_fill = 0;
+}
+
+size_t Channelizer::execute(const std::complex<float> *in, size_t count, std::complex<float> *out) {
+    const std::complex<float> *src = in;
+    for (size_t s = 0; s < halfbands.size(); s++) {
+        count = run_halfband(s, src, count, out);
+        src = out;
+    }
+    return run_final(src, count, out);
+}
+
+size_t Channelizer::run_halfband(size_t stage, const std::complex<float> *in, size_t count, std::complex<float> *out) {
+    resamp2_crcf q = halfbands[stage];
+    size_t written = 0;
+    size_t i = 0;
+    std::complex<float> pair[2];
+
+    if (hb_has_carry[stage] && count > 0) {
+        pair[0] = hb_carry[stage];
+        pair[1] = in[0];
+        resamp2_crcf_decim_execute(q, pair, &out[written++]);
+        hb_has_carry[stage] = false;
+        i = 1;
+    }
+    for (; i + 1 < count; i += 2) {
+        // Copy first, 'out' may alias 'in'
+        pair[0] = in[i];
+        pair[1] = in[i + 1];
+        resamp2_crcf_decim_execute(q, pair, &out[written++]);
+    }
+    if (i < count) {
+        hb_carry[stage] = in[i];
+        hb_has_carry[stage] = true;
+    }
+    return written;
+}
+
+size_t Channelizer::run_final(const std::complex<float> *in, size_t count, std::complex<float> *out) {
+    size_t written = 0;
+    for (size_t i = 0; i < count; i++) {
+        final_buf[final_fill++] = in[i];
+        if (final_fill == final_decim) {
+            std::complex<float> y;
+            firdecim_crcf_execute(final_stage, final_buf.data(), &y);
+            out[written++] = y * gain;
+            final_fill = 0;
+        }
+    }
+    return written;
+}
@@ -0,0 +1,56 @@
+#ifndef _CHANNELIZER_H
+#define _CHANNELIZER_H
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+#include <liquid/liquid.h>
+
+// Multi-stage decimating channel filter. A cascade of halfband decimators
+// brings the input rate down by powers of two towards 'min_output_rate',
+// then a linear-phase polyphase FIR decimator does the final integer step
+// and applies the channel bandwidth. Streams arbitrary block lengths;
+// leftover input samples are carried over to the next call.
+class Channelizer {
+    public:
+        Channelizer(int input_rate, int min_output_rate, float cutoff_hz);
+        ~Channelizer();
+
+        // Filter and decimate 'count' samples. 'out' may alias 'in' and
+        // needs room for count / decimation() + 1 samples. Returns the
+        // number of samples written.
+        size_t execute(const std::complex<float> *in, size_t count, std::complex<float> *out);
+
+        void reset();
+
+        double output_rate() const { return out_rate; }
+        unsigned int decimation() const { return total_decim; }
+        float cutoff() const { return cutoff_hz; }
+        unsigned int halfband_stages() const { return static_cast<unsigned int>(halfbands.size()); }
+        unsigned int final_decimation() const { return final_decim; }
+        unsigned int final_taps() const { return final_len; }
+
+    private:
+        Channelizer(const Channelizer &);
+        Channelizer &operator=(const Channelizer &);
+
+        size_t run_halfband(size_t stage, const std::complex<float> *in, size_t count, std::complex<float> *out);
+        size_t run_final(const std::complex<float> *in, size_t count, std::complex<float> *out);
+
+        std::vector<resamp2_crcf> halfbands;
+        std::vector<std::complex<float>> hb_carry;
+        std::vector<bool> hb_has_carry;
+
+        firdecim_crcf final_stage;
+        unsigned int final_decim;
+        unsigned int final_len;
+        std::vector<std::complex<float>> final_buf;
+        unsigned int final_fill;
+
+        unsigned int total_decim;
+        double out_rate;
+        float cutoff_hz;
+        float gain;  // Corrects the passband gain of the cascade to unity
+};
+
+#endif // _CHANNELIZER_H
@@ -66,6 +66,15 @@ std::vector<std::string> splitString(const std::string& str, char delimiter) {
 }
 
 
+// Modulation name as used in fm_mode and [channels]: am, narrow/nfm, wide/wfm
+ModulationMode parse_mode(const std::string& str) {
+    std::string mode = str;
+    std::transform(mode.begin(), mode.end(), mode.begin(), ::tolower);
+    if (mode == "am") return ModulationMode::AM_MODE;
+    if (mode == "narrow" || mode == "nfm") return ModulationMode::NFM_MODE;
+    return ModulationMode::WFM_MODE;
+}
+
 // Implementation of parse_config function
 Config parse_config(const std::string &filename) {
     Config config;
@@ -99,9 +108,101 @@ Config parse_config(const std::string &filename) {
             std::string mode = section["fm_mode"];
             std::transform(mode.begin(), mode.end(), mode.begin(), ::tolower);
             config.wide_fm = (mode == "wide");
-            if (mode == "am") config.mode = ModulationMode::AM_MODE;
-            else if (mode == "narrow") config.mode = ModulationMode::NFM_MODE;
-            else config.mode = ModulationMode::WFM_MODE;
+            config.mode = parse_mode(mode);
+        }
+        
+        if (section.count("iq_convert")) {
+            config.iq_convert = section["iq_convert"];
+            std::transform(config.iq_convert.begin(), config.iq_convert.end(), config.iq_convert.begin(), ::tolower);
+        }
+        
+        if (section.count("fm_discriminator")) {
+            config.fm_discriminator = section["fm_discriminator"];
+            std::transform(config.fm_discriminator.begin(), config.fm_discriminator.end(), config.fm_discriminator.begin(), ::tolower);
+        }
+        
+        if (section.count("dsp_cpu")) {
+            config.dsp_cpu = std::stoi(section["dsp_cpu"]);
+        }
+        
+        if (section.count("dsp_queue_blocks")) {
+            config.dsp_queue_blocks = std::max(2, std::stoi(section["dsp_queue_blocks"]));
+        }
+    }
+    
+    // Parse wfm section
+    if (ini_data.count("wfm")) {
+        auto& section = ini_data["wfm"];
+        
+        if (section.count("stereo")) {
+            std::string stereo = section["stereo"];
+            std::transform(stereo.begin(), stereo.end(), stereo.begin(), ::tolower);
+            config.wfm_stereo = (stereo == "true" || stereo == "1");
+        }
+        
+        if (section.count("rds")) {
+            std::string rds = section["rds"];
+            std::transform(rds.begin(), rds.end(), rds.begin(), ::tolower);
+            config.wfm_rds = (rds == "true" || rds == "1");
+        }
+        
+        if (section.count("deemphasis")) {
+            std::string deemphasis = section["deemphasis"];
+            std::transform(deemphasis.begin(), deemphasis.end(), deemphasis.begin(), ::tolower);
+            if (deemphasis == "none" || deemphasis == "off") {
+                config.wfm_deemphasis_us = 0.0f;
+            } else {
+                config.wfm_deemphasis_us = std::max(0.0f, std::stof(deemphasis));
+            }
+        }
+    }
+    
+    // Parse am section
+    if (ini_data.count("am")) {
+        auto& section = ini_data["am"];
+        
+        if (section.count("detector")) {
+            config.am_detector = section["detector"];
+            std::transform(config.am_detector.begin(), config.am_detector.end(), config.am_detector.begin(), ::tolower);
+        }
+        
+        if (section.count("agc")) {
+            std::string agc = section["agc"];
+            std::transform(agc.begin(), agc.end(), agc.begin(), ::tolower);
+            config.am_agc = (agc == "true" || agc == "1");
+        }
+        
+        if (section.count("agc_attack_ms")) {
+            config.am_agc_attack_ms = std::max(0.0f, std::stof(section["agc_attack_ms"]));
+        }
+        
+        if (section.count("agc_release_ms")) {
+            config.am_agc_release_ms = std::max(0.0f, std::stof(section["agc_release_ms"]));
+        }
+    }
+    
+    // Parse input section
+    if (ini_data.count("input")) {
+        auto& section = ini_data["input"];
+        
+        if (section.count("source")) {
+            config.input_source = section["source"];
+            std::transform(config.input_source.begin(), config.input_source.end(), config.input_source.begin(), ::tolower);
+        }
+        
+        if (section.count("file")) {
+            config.input_file = section["file"];
+        }
+        
+        if (section.count("format")) {
+            config.input_format = section["format"];
+            std::transform(config.input_format.begin(), config.input_format.end(), config.input_format.begin(), ::tolower);
+        }
+        
+        if (section.count("realtime")) {
+            std::string realtime = section["realtime"];
+            std::transform(realtime.begin(), realtime.end(), realtime.begin(), ::tolower);
+            config.input_realtime = (realtime == "true" || realtime == "1");
         }
     }
     
@@ -110,7 +211,9 @@ Config parse_config(const std::string &filename) {
         auto& section = ini_data["audio"];
         
         if (section.count("audio_rate")) {
-            config.audio_rate = std::stoi(section["audio_rate"]);
+            std::string rate = section["audio_rate"];
+            std::transform(rate.begin(), rate.end(), rate.begin(), ::tolower);
+            config.audio_rate = (rate == "auto") ? 0 : std::stoi(rate);
         }
         
         if (section.count("mp3_bitrate")) {
@@ -124,6 +227,49 @@ Config parse_config(const std::string &filename) {
         if (section.count("audio_buffer_seconds")) {
             config.audio_buffer_seconds = std::stoi(section["audio_buffer_seconds"]);
         }
+        
+        if (section.count("low_latency")) {
+            std::string enabled = section["low_latency"];
+            std::transform(enabled.begin(), enabled.end(), enabled.begin(), ::tolower);
+            config.low_latency = (enabled == "true" || enabled == "yes" || enabled == "1");
+        }
+        
+        if (section.count("prebuffer_ms")) {
+            config.prebuffer_ms = std::stoi(section["prebuffer_ms"]);
+        }
+        
+        if (section.count("opus_bitrate")) {
+            config.opus_bitrate = std::stoi(section["opus_bitrate"]);
+        }
+        
+        if (section.count("opus_frame_ms")) {
+            config.opus_frame_ms = std::stoi(section["opus_frame_ms"]);
+        }
+        
+        if (section.count("opus_complexity")) {
+            config.opus_complexity = std::min(10, std::max(0, std::stoi(section["opus_complexity"])));
+        }
+    }
+    
+    // Parse audio profile sections, [audio_profile.am|nfm|wfm]
+    for (auto it = ini_data.begin(); it != ini_data.end(); it++) {
+        if (it->first.compare(0, 14, "audio_profile.") != 0 || it->first.size() == 14) {
+            continue;
+        }
+        auto& section = it->second;
+        AudioProfile& profile = config.audio_profiles[static_cast<int>(parse_mode(it->first.substr(14)))];
+
+        if (section.count("audio_rate")) {
+            profile.audio_rate = std::stoi(section["audio_rate"]);
+        }
+
+        if (section.count("mp3_bitrate")) {
+            profile.mp3_bitrate = std::stoi(section["mp3_bitrate"]);
+        }
+
+        if (section.count("opus_bitrate")) {
+            profile.opus_bitrate = std::stoi(section["opus_bitrate"]);
+        }
     }
     
     // Parse audio_filters section
@@ -162,6 +308,20 @@ Config parse_config(const std::string &filename) {
         if (section.count("hold_time")) {
             config.squelch_hold_time = std::stoi(section["hold_time"]);
         }
+        
+        if (section.count("hysteresis")) {
+            config.squelch_hysteresis = std::stof(section["hysteresis"]);
+        }
+        
+        if (section.count("adaptive")) {
+            std::string adaptive = section["adaptive"];
+            std::transform(adaptive.begin(), adaptive.end(), adaptive.begin(), ::tolower);
+            config.squelch_adaptive = (adaptive == "true" || adaptive == "1");
+        }
+        
+        if (section.count("snr")) {
+            config.squelch_snr = std::stof(section["snr"]);
+        }
     }
     
     // Parse icecast section
@@ -194,6 +354,8 @@ Config parse_config(const std::string &filename) {
         
         if (section.count("format")) {
             config.icecast_format = section["format"];
+            std::transform(config.icecast_format.begin(), config.icecast_format.end(),
+                           config.icecast_format.begin(), ::tolower);
         }
         
         if (section.count("station_title")) {
@@ -207,6 +369,68 @@ Config parse_config(const std::string &filename) {
         if (section.count("reconnect_delay_ms")) {
             config.reconnect_delay_ms = std::stoi(section["reconnect_delay_ms"]);
         }
+        
+        if (section.count("queue_overflow")) {
+            config.mp3_queue_overflow = section["queue_overflow"];
+            std::transform(config.mp3_queue_overflow.begin(), config.mp3_queue_overflow.end(),
+                           config.mp3_queue_overflow.begin(), ::tolower);
+        }
+    }
+
+    // Parse icecast output sections, [icecast.<name>], defaulting to [icecast]
+    for (auto it = ini_data.begin(); it != ini_data.end(); it++) {
+        if (it->first.compare(0, 8, "icecast.") != 0 || it->first.size() == 8) {
+            continue;
+        }
+        auto& section = it->second;
+
+        IcecastOutputConfig output;
+        output.name = it->first.substr(8);
+        output.host = section.count("host") ? section["host"] : config.icecast_host;
+        output.port = section.count("port") ? std::stoi(section["port"]) : config.icecast_port;
+        output.mount = section.count("mount") ? section["mount"] : config.icecast_mount;
+        output.user = section.count("user") ? section["user"] : config.icecast_user;
+        output.password = section.count("password") ? section["password"] : config.icecast_password;
+        output.reconnect_attempts = section.count("reconnect_attempts") ?
+            std::stoi(section["reconnect_attempts"]) : config.reconnect_attempts;
+        output.reconnect_delay_ms = section.count("reconnect_delay_ms") ?
+            std::stoi(section["reconnect_delay_ms"]) : config.reconnect_delay_ms;
+        output.queue_overflow = section.count("queue_overflow") ? section["queue_overflow"] : config.mp3_queue_overflow;
+        std::transform(output.queue_overflow.begin(), output.queue_overflow.end(),
+                       output.queue_overflow.begin(), ::tolower);
+        config.icecast_outputs.push_back(output);
+    }
+    if (config.icecast_outputs.empty()) {
+        IcecastOutputConfig output;
+        output.name = "icecast";
+        output.host = config.icecast_host;
+        output.port = config.icecast_port;
+        output.mount = config.icecast_mount;
+        output.user = config.icecast_user;
+        output.password = config.icecast_password;
+        output.reconnect_attempts = config.reconnect_attempts;
+        output.reconnect_delay_ms = config.reconnect_delay_ms;
+        output.queue_overflow = config.mp3_queue_overflow;
+        config.icecast_outputs.push_back(output);
+    }
+
+    // Parse metrics section
+    if (ini_data.count("metrics")) {
+        auto& section = ini_data["metrics"];
+
+        if (section.count("enabled")) {
+            std::string enabled = section["enabled"];
+            std::transform(enabled.begin(), enabled.end(), enabled.begin(), ::tolower);
+            config.metrics_enabled = (enabled == "true" || enabled == "1");
+        }
+
+        if (section.count("bind")) {
+            config.metrics_bind = section["bind"];
+        }
+
+        if (section.count("port")) {
+            config.metrics_port = std::stoi(section["port"]);
+        }
     }
 
     // Parse scan section
@@ -219,6 +443,11 @@ Config parse_config(const std::string &filename) {
             config.scanEnabled = (enabled == "true" || enabled == "1");
         }
 
+        if (section.count("mode")) {
+            config.scan_mode = section["mode"];
+            std::transform(config.scan_mode.begin(), config.scan_mode.end(), config.scan_mode.begin(), ::tolower);
+        }
+
         if (section.count("step_delay")) {
             config.step_delay_ms = std::stoi(section["step_delay"]);
         }
@@ -240,6 +469,29 @@ Config parse_config(const std::string &filename) {
         }
     }
 
+    // Parse channels section: name = offset_khz,mode,squelch_db|off,mount
+    if (ini_data.count("channels")) {
+        auto& section = ini_data["channels"];
+
+        for (std::map<std::string, std::string>::iterator it = section.begin(); it != section.end(); it++) {
+            std::vector<std::string> result = splitString(it->second, ',');
+            if (result.size() < 4) {
+                throw std::runtime_error("Channel " + it->first + " needs offset_khz,mode,squelch,mount");
+            }
+
+            ChannelConfig channel;
+            channel.name = it->first;
+            channel.offset_hz = std::stod(trim(result[0])) * 1000.0;
+            channel.mode = parse_mode(trim(result[1]));
+            std::string squelch = trim(result[2]);
+            std::transform(squelch.begin(), squelch.end(), squelch.begin(), ::tolower);
+            channel.squelch_enabled = (squelch != "off");
+            channel.squelch_threshold = channel.squelch_enabled ? std::stof(squelch) : config.squelch_threshold;
+            channel.mount = trim(result[3]);
+            config.channels.push_back(channel);
+        }
+    }
+
     return config;
 }
 
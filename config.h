@@ -16,6 +16,64 @@ enum class ModulationMode {
     WFM_MODE
 };
 
+// Audio rate and codec bitrates for one modulation, used with
+// audio_rate = auto so voice channels are not processed at broadcast rates
+struct AudioProfile {
+    int audio_rate;
+    int mp3_bitrate;           // in kbps
+    int opus_bitrate;          // in kbps
+    int channels;              // 2 for stereo WFM, audio is interleaved
+
+    AudioProfile(int audio_rate = 48000, int mp3_bitrate = 128, int opus_bitrate = 64) :
+        audio_rate(audio_rate),
+        mp3_bitrate(mp3_bitrate),
+        opus_bitrate(opus_bitrate),
+        channels(1)
+    {}
+
+    // Interleaved samples per second, to turn buffer sizes into time
+    int samples_per_second() const { return audio_rate * channels; }
+};
+
+// One demodulated output of a multi-channel receiver, placed inside the
+// tuned passband by its offset from the center frequency
+struct ChannelConfig {
+    std::string name;
+    double offset_hz;          // Channel frequency minus center frequency
+    ModulationMode mode;
+    bool squelch_enabled;
+    float squelch_threshold;   // in dB
+    std::string mount;         // Icecast mount point for this channel
+    AudioProfile audio;        // Resolved at startup from [audio] or the mode's profile
+
+    ChannelConfig() :
+        offset_hz(0.0),
+        mode(ModulationMode::WFM_MODE),
+        squelch_enabled(false),
+        squelch_threshold(-30.0f)
+    {}
+};
+
+// One Icecast server every channel is streamed to, from an
+// [icecast.<name>] section; unset keys are taken from [icecast]
+struct IcecastOutputConfig {
+    std::string name;
+    std::string host;
+    int port;
+    std::string mount;         // Ignored when [channels] gives each channel a mount
+    std::string user;
+    std::string password;
+    int reconnect_attempts;
+    int reconnect_delay_ms;
+    std::string queue_overflow;
+
+    IcecastOutputConfig() :
+        port(8000),
+        reconnect_attempts(5),
+        reconnect_delay_ms(2000)
+    {}
+};
+
 struct Config {
     // RTL-SDR settings
     int sample_rate;
@@ -25,24 +83,58 @@ struct Config {
     int ppm_correction;  // frequency correction in PPM
     bool wide_fm;
     ModulationMode mode;
+    std::string iq_convert;  // auto, scalar, lut, sse2, avx2 or neon
+    std::string fm_discriminator;  // fast or exact
+    int dsp_cpu;           // CPU core to pin the DSP thread to, -1 = no pinning
+    int dsp_queue_blocks;  // Raw IQ blocks buffered between USB and DSP threads
+
+    // Broadcast FM settings
+    bool wfm_stereo;       // Decode the stereo multiplex of WFM channels
+    bool wfm_rds;          // Decode RDS station name and radiotext
+    float wfm_deemphasis_us;  // De-emphasis time constant, 75 or 50, 0 = none
+
+    // AM settings
+    std::string am_detector;   // envelope or sync
+    bool am_agc;
+    float am_agc_attack_ms;
+    float am_agc_release_ms;
+
+    // Input settings
+    std::string input_source;   // rtlsdr or file
+    std::string input_file;     // IQ recording, for input_source = file
+    std::string input_format;   // auto, cu8, cf32 or sigmf
+    bool input_realtime;        // Replay at the sample rate, or as fast as possible
 
     // Scanner settings
     bool scanEnabled;
+    std::string scan_mode;      // step (retune per entry) or passband
     uint16_t step_delay_ms;
 
     // Scanlist
     std::vector<ScanList> scanlist;
 
+    // Channels received in parallel, empty = a single channel at the center
+    std::vector<ChannelConfig> channels;
+
     // Audio settings
-    int audio_rate;
+    int audio_rate;             // in Hz, 0 = auto (audio_profiles by mode)
     int mp3_bitrate;
     int mp3_quality;
-    int audio_buffer_seconds;
+    int audio_buffer_seconds;   // Audio encoded per chunk, unless low_latency
+    bool low_latency;           // One MP3 frame per chunk and small USB blocks
+    int prebuffer_ms;           // Audio buffered before encoding, 0 = default
+    int opus_bitrate;           // in kbps, when icecast_format = opus
+    int opus_frame_ms;          // 5, 10, 20, 40 or 60
+    int opus_complexity;        // 0 (fastest) to 10 (best)
+    AudioProfile audio_profiles[3];  // Indexed by ModulationMode, for audio_rate = auto
     
     // Squelch settings
     bool squelch_enabled;
     float squelch_threshold;    // in dB
     int squelch_hold_time;      // in milliseconds
+    float squelch_hysteresis;   // in dB, closes this far below the opening level
+    bool squelch_adaptive;      // Open relative to the tracked noise floor
+    float squelch_snr;          // in dB above the noise floor, when adaptive
     
     // Audio filter settings
     bool lowcut_enabled;        // Enable low-cut filter
@@ -56,13 +148,23 @@ struct Config {
     std::string icecast_password;
     std::string icecast_user;
     std::string icecast_protocol;
-    std::string icecast_format;
+    std::string icecast_format;      // mp3, or opus (Ogg) when built with libopus
     int reconnect_attempts;
     int reconnect_delay_ms;
+    std::string mp3_queue_overflow;  // drop_oldest, drop_newest or block
 
     // New station title setting
     std::string icecast_station_title;
 
+    // Servers the encoded stream is sent to, in section name order. Just
+    // [icecast] itself when there are no [icecast.<name>] sections.
+    std::vector<IcecastOutputConfig> icecast_outputs;
+
+    // Metrics settings
+    bool metrics_enabled;       // Serve Prometheus metrics over HTTP
+    std::string metrics_bind;   // Address to listen on
+    int metrics_port;
+
     // Constructor with default values
     Config() :
         sample_rate(1024000),
@@ -71,15 +173,39 @@ struct Config {
         tuner_gain(0),
         ppm_correction(0),
         wide_fm(true),
+        mode(ModulationMode::WFM_MODE),
+        iq_convert("auto"),
+        fm_discriminator("fast"),
+        dsp_cpu(-1),
+        dsp_queue_blocks(8),
+        wfm_stereo(false),
+        wfm_rds(false),
+        wfm_deemphasis_us(75.0f),
+        am_detector("envelope"),
+        am_agc(true),
+        am_agc_attack_ms(10.0f),
+        am_agc_release_ms(500.0f),
+        input_source("rtlsdr"),
+        input_format("auto"),
+        input_realtime(true),
         scanEnabled(false),
+        scan_mode("step"),
         step_delay_ms(100),
         audio_rate(48000),
         mp3_bitrate(128),
         mp3_quality(2),
         audio_buffer_seconds(2),
+        low_latency(false),
+        prebuffer_ms(0),
+        opus_bitrate(24),
+        opus_frame_ms(20),
+        opus_complexity(10),
         squelch_enabled(false),
         squelch_threshold(-30.0f),
         squelch_hold_time(500),
+        squelch_hysteresis(3.0f),
+        squelch_adaptive(false),
+        squelch_snr(10.0f),
         lowcut_enabled(false),
         lowcut_freq(300.0f),    // 300 Hz default cutoff
         lowcut_order(4),        // 4th order filter by default
@@ -92,8 +218,17 @@ struct Config {
         icecast_format("mp3"),
         reconnect_attempts(5),
         reconnect_delay_ms(2000),
-        icecast_station_title("RTL-SDR Radio")
-    {}
+        mp3_queue_overflow("drop_newest"),
+        icecast_station_title("RTL-SDR Radio"),
+        metrics_enabled(false),
+        metrics_bind("0.0.0.0"),
+        metrics_port(9180)
+    {
+        // AM and NFM voice ends around 3-4 kHz, broadcast FM at 15 kHz
+        audio_profiles[static_cast<int>(ModulationMode::AM_MODE)] = AudioProfile(8000, 24, 16);
+        audio_profiles[static_cast<int>(ModulationMode::NFM_MODE)] = AudioProfile(16000, 32, 20);
+        audio_profiles[static_cast<int>(ModulationMode::WFM_MODE)] = AudioProfile(48000, 128, 64);
+    }
 };
 
 namespace ConfigParser {
@@ -101,6 +236,7 @@ namespace ConfigParser {
     std::string trim(const std::string& str);
     std::string remove_comment(const std::string& str);
     std::map<std::string, std::map<std::string, std::string>> parse_ini(const std::string& filename);
+    ModulationMode parse_mode(const std::string& str);
     
     // Only declare the function, don't define it
     Config parse_config(const std::string &filename);
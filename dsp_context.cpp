@@ -0,0 +1,48 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include "dsp_context.h"
+
+void *dsp_aligned_alloc(size_t bytes) {
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, DSP_BUFFER_ALIGNMENT, bytes ? bytes : DSP_BUFFER_ALIGNMENT) != 0) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void dsp_aligned_free(void *ptr) {
+    free(ptr);
+}
+
+DspContext::DspContext(size_t max_iq_samples, int sample_rate, int audio_rate) :
+    resamp_ratio(static_cast<double>(audio_rate) / sample_rate),
+    hot_allocs(0)
+{
+    iq.reserve(max_iq_samples);
+    filtered.reserve(max_iq_samples);
+    demod.reserve(max_real_samples(max_iq_samples));
+    resampled.reserve(max_real_samples(max_iq_samples));
+}
+
+void DspContext::prepare(size_t iq_samples) {
+    size_t grown = 0;
+    grown += iq.reserve(iq_samples);
+    grown += filtered.reserve(iq_samples);
+    grown += demod.reserve(max_real_samples(iq_samples));
+    grown += resampled.reserve(max_real_samples(iq_samples));
+    if (grown) {
+        hot_allocs.fetch_add(grown, std::memory_order_relaxed);
+    }
+}
+
+size_t DspContext::max_audio_samples(size_t iq_samples) const {
+    // msresamp can emit a few samples more than the nominal ratio while
+    // its internal delay lines fill, leave generous headroom for that
+    return static_cast<size_t>(std::ceil(iq_samples * resamp_ratio)) + 64;
+}
+
+size_t DspContext::max_real_samples(size_t iq_samples) const {
+    return std::max(iq_samples, max_audio_samples(iq_samples));
+}
@@ -0,0 +1,77 @@
+#ifndef _DSP_CONTEXT_H
+#define _DSP_CONTEXT_H
+
+#include <atomic>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+
+#define DSP_BUFFER_ALIGNMENT 64  // Cache line, also enough for AVX/NEON loads
+
+void *dsp_aligned_alloc(size_t bytes);
+void dsp_aligned_free(void *ptr);
+
+// Heap buffer with cache-line alignment that only reallocates when it has
+// to grow. Contents are not preserved across a grow.
+template <typename T>
+class AlignedBuffer {
+    public:
+        AlignedBuffer() : ptr(nullptr), cap(0) {}
+        ~AlignedBuffer() { dsp_aligned_free(ptr); }
+
+        // Returns true if the buffer had to be reallocated
+        bool reserve(size_t count) {
+            if (count <= cap) {
+                return false;
+            }
+            dsp_aligned_free(ptr);
+            ptr = static_cast<T *>(dsp_aligned_alloc(count * sizeof(T)));
+            cap = count;
+            return true;
+        }
+
+        T *data() { return ptr; }
+        const T *data() const { return ptr; }
+        size_t capacity() const { return cap; }
+        T &operator[](size_t i) { return ptr[i]; }
+        const T &operator[](size_t i) const { return ptr[i]; }
+
+    private:
+        AlignedBuffer(const AlignedBuffer &);
+        AlignedBuffer &operator=(const AlignedBuffer &);
+
+        T *ptr;
+        size_t cap;
+};
+
+// Scratch buffers for one USB block worth of DSP work. Sized once at
+// startup so the callback never touches the allocator in steady state;
+// any later growth is counted so it shows up in the status line.
+class DspContext {
+    public:
+        DspContext(size_t max_iq_samples, int sample_rate, int audio_rate);
+
+        // Make sure the buffers fit a block of 'iq_samples' samples. Called
+        // from the hot path, so a reallocation here is counted.
+        void prepare(size_t iq_samples);
+
+        // Upper bound of resampler output for 'iq_samples' input samples
+        size_t max_audio_samples(size_t iq_samples) const;
+
+        // Size of each real-valued buffer; they hold demodulated audio at
+        // the channel rate as well as resampled audio
+        size_t max_real_samples(size_t iq_samples) const;
+
+        size_t hot_path_allocations() const { return hot_allocs.load(std::memory_order_relaxed); }
+
+        AlignedBuffer<std::complex<float>> iq;
+        AlignedBuffer<std::complex<float>> filtered;
+        AlignedBuffer<float> demod;
+        AlignedBuffer<float> resampled;
+
+    private:
+        double resamp_ratio;
+        std::atomic<size_t> hot_allocs;
+};
+
+#endif // _DSP_CONTEXT_H
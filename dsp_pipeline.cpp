@@ -0,0 +1,581 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "dsp_pipeline.h"
+#include "iq_convert.h"
+
+#define NFM_FILTER_BW 12500*2  
+
+#define WFM_FILTER_BW 120000  // 120 kHz for WFM
+
+#define AM_FILTER_BW  8000    // 8 kHz for AM
+
+// Lowest intermediate (channel) rate per mode, the channelizer decimates
+// the IQ stream to the first rate at or above this before demodulation
+#define WFM_CHANNEL_RATE 240000
+#define NFM_CHANNEL_RATE 60000
+#define AM_CHANNEL_RATE  24000
+
+#define SQUELCH_WINDOW_MS 5          // Squelch decision granularity
+#define SQUELCH_FLOOR_RISE_DB_S 1.0f // Noise floor creep while closed
+#define SQUELCH_EVENT_QUEUE 64
+
+size_t IqConvertStage::process(Span<const uint8_t> in, Span<std::complex<float>> out) {
+    size_t samples = std::min(in.size / iq_sample_bytes(format), out.size);
+    iq_convert(format, in.data, out.data, samples);
+    return samples;
+}
+
+MixerStage::MixerStage(double offset_hz, double sample_rate) {
+    nco = nco_crcf_create(LIQUID_NCO);
+    set_offset(offset_hz, sample_rate);
+}
+
+void MixerStage::set_offset(double offset_hz, double sample_rate) {
+    nco_crcf_set_frequency(nco, static_cast<float>(2.0 * M_PI * offset_hz / sample_rate));
+}
+
+MixerStage::~MixerStage() {
+    nco_crcf_destroy(nco);
+}
+
+size_t MixerStage::process(Span<const std::complex<float>> in, Span<std::complex<float>> out) {
+    size_t n = std::min(in.size, out.size);
+    nco_crcf_mix_block_down(nco, const_cast<std::complex<float> *>(in.data), out.data, n);
+    return n;
+}
+
+ChannelizerStage::ChannelizerStage(int input_rate, int min_output_rate, float cutoff_hz) :
+    channelizer(input_rate, min_output_rate, cutoff_hz)
+{
+}
+
+size_t ChannelizerStage::process(Span<const std::complex<float>> in, Span<std::complex<float>> out) {
+    return channelizer.execute(in.data, in.size, out.data);
+}
+
+SquelchStage::SquelchStage(bool enabled, float threshold_db, int hold_ms,
+                           float hysteresis_db, bool adaptive, float snr_db) :
+    enabled(enabled),
+    threshold_db(threshold_db),
+    hold_ms(hold_ms),
+    hysteresis_db(hysteresis_db),
+    adaptive(adaptive),
+    snr_db(snr_db),
+    window(1),
+    window_seconds(0.0f),
+    hold_samples(0),
+    open(false),
+    floor_valid(false),
+    samples(0),
+    last_above(0),
+    block_first_sample(0),
+    level(-120.0f),
+    noise_floor(-120.0f),
+    is_muted(false),
+    checked_time(0.0),
+    open_time(0.0)
+{
+}
+
+void SquelchStage::set_rate(double rate, size_t max_block) {
+    window = std::max<size_t>(1, static_cast<size_t>(rate * SQUELCH_WINDOW_MS / 1000.0));
+    window_seconds = static_cast<float>(window / rate);
+    hold_samples = static_cast<uint64_t>(rate * hold_ms / 1000.0);
+
+    // At most one transition per window
+    size_t max_windows = max_block / window + 1;
+    windows_open.reserve(max_windows);
+    block_events.reserve(max_windows);
+}
+
+void SquelchStage::reset() {
+    open = false;
+    floor_valid = false;
+    is_muted.store(enabled, std::memory_order_relaxed);
+}
+
+void SquelchStage::transition(bool to_open, uint64_t sample, float db) {
+    open = to_open;
+    SquelchEvent event;
+    event.open = to_open;
+    event.channel_sample = sample;
+    event.audio_sample = 0;  // Filled in by DspPipeline
+    event.level_db = db;
+    event.noise_floor_db = noise_floor.load(std::memory_order_relaxed);
+    block_events.push_back(event);
+}
+
+size_t SquelchStage::process(Span<const std::complex<float>> in, Span<std::complex<float>> out) {
+    block_first_sample = samples;
+    block_events.clear();
+    windows_open.clear();
+
+    // Signal strength of the whole block (RMS of the channel samples), for display
+    float sum_squared = 0.0f;
+    for (size_t i = 0; i < in.size; i++) {
+        sum_squared += std::norm(in[i]);
+    }
+    float rms = std::sqrt(sum_squared / std::max<size_t>(in.size, 1));
+    level.store(20 * std::log10(rms + 1e-10f), std::memory_order_relaxed);
+
+    if (enabled) {
+        size_t open_windows = 0;
+        for (size_t start = 0; start < in.size; start += window) {
+            size_t end = std::min(start + window, in.size);
+            float power = 0.0f;
+            for (size_t i = start; i < end; i++) {
+                power += std::norm(in[i]);
+            }
+            float db = 10 * std::log10(power / (end - start) + 1e-20f);
+            uint64_t pos = samples + start;
+
+            // Noise floor follows dips at once and rises slowly, and only
+            // while closed so a long transmission is not learned as noise
+            if (adaptive && !open) {
+                float nf = noise_floor.load(std::memory_order_relaxed);
+                if (!floor_valid || db < nf) {
+                    nf = db;
+                    floor_valid = true;
+                } else {
+                    nf += SQUELCH_FLOOR_RISE_DB_S * window_seconds;
+                }
+                noise_floor.store(nf, std::memory_order_relaxed);
+            }
+
+            float open_db = adaptive ? noise_floor.load(std::memory_order_relaxed) + snr_db : threshold_db;
+            if (!open) {
+                if (db >= open_db) {
+                    transition(true, pos, db);
+                    last_above = pos + (end - start);
+                }
+            } else if (db >= open_db - hysteresis_db) {
+                last_above = pos + (end - start);
+            } else if (pos + (end - start) - last_above > hold_samples) {
+                transition(false, pos, db);
+            }
+            windows_open.push_back(open ? 1 : 0);
+            open_windows += open ? 1 : 0;
+        }
+        checked_time.store(checked_time.load(std::memory_order_relaxed) +
+            windows_open.size() * (double)window_seconds, std::memory_order_relaxed);
+        open_time.store(open_time.load(std::memory_order_relaxed) +
+            open_windows * (double)window_seconds, std::memory_order_relaxed);
+    }
+    samples += in.size;
+    is_muted.store(enabled && !open, std::memory_order_relaxed);
+
+    if (out.data != in.data) {
+        std::copy(in.data, in.data + in.size, out.data);
+    }
+    return in.size;
+}
+
+FmDemodStage::FmDemodStage(ModulationMode mode, double rate, FmDiscriminator disc) {
+    demod.setMode(mode, rate);
+    demod.setDiscriminator(disc);
+    demod.reset();
+}
+
+size_t FmDemodStage::process(Span<const std::complex<float>> in, Span<float> out) {
+    demod.demodulate(in.data, out.data, in.size);
+    return in.size;
+}
+
+AmDemodStage::AmDemodStage(AmDetector detector, double rate, bool agc, float attack_ms, float release_ms) {
+    demod.configure(detector, rate, agc, attack_ms, release_ms);
+}
+
+size_t AmDemodStage::process(Span<const std::complex<float>> in, Span<float> out) {
+    demod.demodulate(in.data, out.data, in.size);
+    return in.size;
+}
+
+ResamplerStage::ResamplerStage(double input_rate, double output_rate) :
+    rate_out(output_rate)
+{
+    resampler = msresamp_rrrf_create(static_cast<float>(output_rate / input_rate), 60.0f);
+}
+
+ResamplerStage::~ResamplerStage() {
+    msresamp_rrrf_destroy(resampler);
+}
+
+size_t ResamplerStage::process(Span<const float> in, Span<float> out) {
+    unsigned int num_written = 0;
+    msresamp_rrrf_execute(resampler,
+                         const_cast<float *>(in.data),
+                         in.size,
+                         out.data,
+                         &num_written);
+    return num_written;
+}
+
+WfmStereoStage::WfmStereoStage(double mpx_rate, int audio_rate, bool stereo, float deemphasis_us, RdsDecoder *rds,
+                               size_t max_block) :
+    decoder(mpx_rate, audio_rate, stereo, deemphasis_us, rds, max_block),
+    rate_out(audio_rate)
+{
+}
+
+size_t WfmStereoStage::process(Span<const float> in, Span<float> out) {
+    return decoder.process(in.data, in.size, out.data, out.size);
+}
+
+size_t DeemphasisStage::process(Span<const float> in, Span<float> out) {
+    if (out.data != in.data) {
+        std::copy(in.data, in.data + in.size, out.data);
+    }
+    filter.process(out.data, in.size);
+    return in.size;
+}
+
+LowCutStage::LowCutStage(float cutoff_hz, int order, int audio_rate, int channels) {
+    // Calculate normalized cutoff frequency
+    float cutoff_norm = cutoff_hz / (float)audio_rate;
+    
+    for (int c = 0; c < channels; c++) {
+        filters.push_back(iirfilt_rrrf_create_prototype(
+            LIQUID_IIRDES_BUTTER,      // Butterworth filter type
+            LIQUID_IIRDES_HIGHPASS,    // High-pass filter (low-cut)
+            LIQUID_IIRDES_SOS,         // Second-order sections
+            order,                     // Filter order
+            cutoff_norm,               // Normalized cutoff frequency
+            0.0f,                      // Unused for high-pass
+            1.0f,                      // Pass-band ripple (unused for Butterworth)
+            60.0f                      // Stop-band attenuation
+        ));
+    }
+}
+
+LowCutStage::~LowCutStage() {
+    for (size_t c = 0; c < filters.size(); c++) {
+        iirfilt_rrrf_destroy(filters[c]);
+    }
+}
+
+void LowCutStage::reset() {
+    for (size_t c = 0; c < filters.size(); c++) {
+        iirfilt_rrrf_reset(filters[c]);
+    }
+}
+
+size_t LowCutStage::process(Span<const float> in, Span<float> out) {
+    if (filters.size() == 1) {
+        iirfilt_rrrf_execute_block(filters[0], const_cast<float *>(in.data), in.size, out.data);
+        return in.size;
+    }
+    size_t channels = filters.size();
+    for (size_t i = 0; i + channels <= in.size; i += channels) {
+        for (size_t c = 0; c < channels; c++) {
+            iirfilt_rrrf_execute(filters[c], in[i + c], &out[i + c]);
+        }
+    }
+    return in.size;
+}
+
+DspPipeline::DspPipeline(const Config &config, const ChannelConfig &channel, size_t max_block_bytes,
+                         IqSampleFormat format) :
+    config(config),
+    channel(channel),
+    sample_bytes(iq_sample_bytes(format)),
+    ctx(max_block_bytes / sample_bytes, config.sample_rate, channel.audio.samples_per_second()),
+    mixer_stage(nullptr),
+    squelch_stage(nullptr),
+    stereo_stage(nullptr),
+    am_stage(nullptr),
+    current_mode(channel.mode),
+    current_offset(channel.offset_hz),
+    chan_rate(config.sample_rate),
+    audio_out_rate(channel.audio.audio_rate),
+    audio_samples(0),
+    idle_audio(0.0),
+    was_idle(false),
+    active_count(0),
+    idle_count(0),
+    demod_time(0.0),
+    pilot(false),
+    am_gain(0.0f),
+    carrier(false),
+    events(SQUELCH_EVENT_QUEUE)
+{
+    input.reset(new IqConvertStage(format));
+    if (config.wfm_rds) {
+        rds_decoder.reset(new RdsDecoder());
+    }
+
+    if (channel.offset_hz != 0.0) {
+        mixer_stage = new MixerStage(channel.offset_hz, config.sample_rate);
+        channel_stages.push_back(std::unique_ptr<ChannelStage>(mixer_stage));
+        printf("Mixer: channel %s at %+.1f kHz from center\n", channel.name.c_str(), channel.offset_hz / 1000.0);
+    }
+
+    squelch_stage = new SquelchStage(channel.squelch_enabled, channel.squelch_threshold, config.squelch_hold_time,
+                                     config.squelch_hysteresis, config.squelch_adaptive, config.squelch_snr);
+    channel_stages.push_back(std::unique_ptr<ChannelStage>(squelch_stage));
+
+    set_mode(channel.mode);
+}
+
+void DspPipeline::set_mode(ModulationMode mode) {
+    float cutoff_freq;
+    int min_channel_rate;
+    if (mode == ModulationMode::WFM_MODE) {
+        cutoff_freq = WFM_FILTER_BW;
+        min_channel_rate = WFM_CHANNEL_RATE;
+    } else if (mode == ModulationMode::NFM_MODE) {
+        cutoff_freq = NFM_FILTER_BW;
+        min_channel_rate = NFM_CHANNEL_RATE;
+    } else {
+        cutoff_freq = AM_FILTER_BW;
+        min_channel_rate = AM_CHANNEL_RATE;
+    }
+
+    // Channel stages: the (persistent) mixer, decimating filter, then the
+    // (persistent) squelch
+    std::unique_ptr<ChannelStage> mixer_owner;
+    std::unique_ptr<ChannelStage> squelch_owner;
+    for (size_t i = 0; i < channel_stages.size(); i++) {
+        if (channel_stages[i].get() == mixer_stage) {
+            mixer_owner = std::move(channel_stages[i]);
+        } else if (channel_stages[i].get() == squelch_stage) {
+            squelch_owner = std::move(channel_stages[i]);
+        }
+    }
+    ChannelizerStage *chan = new ChannelizerStage(config.sample_rate, min_channel_rate, cutoff_freq);
+    channel_stages.clear();
+    if (mixer_owner) {
+        channel_stages.push_back(std::move(mixer_owner));
+    }
+    channel_stages.push_back(std::unique_ptr<ChannelStage>(chan));
+    channel_stages.push_back(std::move(squelch_owner));
+    chan_rate = chan->get().output_rate();
+    squelch_stage->set_rate(chan_rate, max_channel_samples());
+
+    printf("Channelizer: %d Hz -> %.0f Hz (%u halfband stages, FIR decimate by %u, %u taps)\n",
+           config.sample_rate, chan_rate, chan->get().halfband_stages(),
+           chan->get().final_decimation(), chan->get().final_taps());
+
+    am_stage = nullptr;
+    am_gain.store(0.0f, std::memory_order_relaxed);
+    carrier.store(false, std::memory_order_relaxed);
+    if ((mode == ModulationMode::NFM_MODE) || (mode == ModulationMode::WFM_MODE)) {
+        FmDiscriminator disc = fm_discriminator_parse(config.fm_discriminator);
+        demod.reset(new FmDemodStage(mode, chan_rate, disc));
+        
+        printf("Initialized %s FM mode with %d Hz deviation, %.1f kHz filter and %s discriminator\n",
+            (mode == ModulationMode::WFM_MODE) ? "Wide" : "Narrow",
+            (mode == ModulationMode::WFM_MODE) ? WFM_DEVIATION : NFM_DEVIATION,
+            chan->get().cutoff() / 1000.0f,
+            fm_discriminator_name(disc));
+        if (mode == ModulationMode::WFM_MODE && rds_decoder) {
+            rds_decoder->set_input_rate(chan_rate);
+        }
+    }
+    if (mode == ModulationMode::AM_MODE) {
+        AmDetector detector = am_detector_parse(config.am_detector);
+        am_stage = new AmDemodStage(detector, chan_rate, config.am_agc, config.am_agc_attack_ms, config.am_agc_release_ms);
+        demod.reset(am_stage);
+        printf("Initialized AM mode with %.1f kHz filter, %s detector", chan->get().cutoff() / 1000.0f,
+               am_detector_name(detector));
+        if (config.am_agc) {
+            printf(" and AGC (%.0f ms attack, %.0f ms release)\n", config.am_agc_attack_ms, config.am_agc_release_ms);
+        } else {
+            printf(", no AGC\n");
+        }
+    }
+
+    current_mode = mode;
+    set_lowcut(config.lowcut_enabled, config.lowcut_freq, config.lowcut_order);
+}
+
+void DspPipeline::set_offset(double offset_hz) {
+    if (!mixer_stage) {
+        mixer_stage = new MixerStage(offset_hz, config.sample_rate);
+        channel_stages.insert(channel_stages.begin(), std::unique_ptr<ChannelStage>(mixer_stage));
+    } else {
+        mixer_stage->set_offset(offset_hz, config.sample_rate);
+    }
+    current_offset = offset_hz;
+}
+
+void DspPipeline::set_lowcut(bool enabled, float freq, int order) {
+    // The resampler is rebuilt too, its ratio follows the channel rate.
+    // WFM with stereo or RDS decodes the multiplex instead, which
+    // resamples as well.
+    audio_stages.clear();
+    stereo_stage = nullptr;
+    bool stereo = channel.audio.channels == 2;
+    int lowcut_channels = 1;
+    if (current_mode == ModulationMode::WFM_MODE && (stereo || rds_decoder)) {
+        stereo_stage = new WfmStereoStage(chan_rate, audio_out_rate, stereo, config.wfm_deemphasis_us, rds_decoder.get(),
+                                          max_channel_samples());
+        audio_stages.push_back(std::unique_ptr<AudioStage>(stereo_stage));
+        lowcut_channels = stereo_stage->get().channels();
+        printf("Initialized WFM %s decoder: 19 kHz pilot PLL, %.0f Hz -> %.0f Hz (%u taps) -> %d Hz%s\n",
+               stereo ? "stereo" : "mono", chan_rate, stereo_stage->get().intermediate_rate(),
+               stereo_stage->get().taps(), audio_out_rate, rds_decoder ? ", RDS" : "");
+    } else {
+        audio_stages.push_back(std::unique_ptr<AudioStage>(new ResamplerStage(chan_rate, audio_out_rate)));
+        if (current_mode == ModulationMode::WFM_MODE && config.wfm_deemphasis_us > 0.0f) {
+            audio_stages.push_back(std::unique_ptr<AudioStage>(new DeemphasisStage(config.wfm_deemphasis_us, audio_out_rate)));
+        }
+    }
+    if (current_mode == ModulationMode::WFM_MODE) {
+        if (config.wfm_deemphasis_us > 0.0f) {
+            printf("Initialized %.0f us de-emphasis\n", config.wfm_deemphasis_us);
+        } else {
+            printf("De-emphasis disabled\n");
+        }
+    }
+
+    if (enabled) {
+        audio_stages.push_back(std::unique_ptr<AudioStage>(new LowCutStage(freq, order, audio_out_rate, lowcut_channels)));
+        printf("Initialized low-cut filter at %.1f Hz (order %d)\n", freq, order);
+    } else {
+        printf("Low-cut filter disabled\n");
+    }
+}
+
+size_t DspPipeline::max_channel_samples() const {
+    // The channelizer only decimates; one extra sample covers its phase
+    return static_cast<size_t>(std::ceil(ctx.iq.capacity() * chan_rate / config.sample_rate)) + 1;
+}
+
+Span<const float> DspPipeline::process(const uint8_t *iq, size_t len) {
+    size_t samples = len / sample_bytes;
+    ctx.prepare(samples);
+
+    // Complex stages ping-pong between the two complex scratch buffers
+    std::complex<float> *cbuf[2] = { ctx.iq.data(), ctx.filtered.data() };
+    size_t n = input->process(Span<const uint8_t>(iq, len),
+                              Span<std::complex<float>>(cbuf[0], samples));
+    int c = 0;
+    for (size_t i = 0; i < channel_stages.size(); i++) {
+        n = channel_stages[i]->process(Span<const std::complex<float>>(cbuf[c], n),
+                                       Span<std::complex<float>>(cbuf[c ^ 1], samples));
+        c ^= 1;
+    }
+    size_t channel_samples = n;
+
+    float *abuf[2] = { ctx.demod.data(), ctx.resampled.data() };
+    size_t audio_cap = std::min(ctx.demod.capacity(), ctx.resampled.capacity());
+
+    // Squelch closed for the whole block: skip demod and resampling and
+    // output the silence they would have produced
+    size_t channels = channel.audio.channels;
+    const std::vector<uint8_t> &open = squelch_stage->window_open();
+    if (squelch_stage->is_enabled() && std::find(open.begin(), open.end(), 1) == open.end()) {
+        idle_audio += channel_samples * static_cast<double>(audio_out_rate) / chan_rate;
+        size_t silent = std::min(static_cast<size_t>(idle_audio), audio_cap / channels);
+        idle_audio -= silent;
+        silent *= channels;
+        std::fill(abuf[0], abuf[0] + silent, 0.0f);
+        queue_squelch_events(silent, channel_samples);
+        audio_samples += silent;
+        was_idle = true;
+        idle_count.fetch_add(1, std::memory_order_relaxed);
+        return Span<const float>(abuf[0], silent);
+    }
+    if (was_idle) {
+        // History from before the gap would only add a click
+        demod->reset();
+        for (size_t i = 0; i < audio_stages.size(); i++) {
+            audio_stages[i]->reset();
+        }
+        was_idle = false;
+    }
+
+    // Real stages likewise between the two audio buffers
+    auto demod_start = std::chrono::steady_clock::now();
+    n = demod->process(Span<const std::complex<float>>(cbuf[c], n), Span<float>(abuf[0], audio_cap));
+    int a = 0;
+    for (size_t i = 0; i < audio_stages.size(); i++) {
+        n = audio_stages[i]->process(Span<const float>(abuf[a], n), Span<float>(abuf[a ^ 1], audio_cap));
+        a ^= 1;
+    }
+    if (channels == 2 && (!stereo_stage || stereo_stage->get().channels() == 1)) {
+        // A stereo stream scanning through other modes
+        n = to_stereo(abuf[a], n, abuf[a ^ 1], audio_cap);
+        a ^= 1;
+    }
+    pilot.store(stereo_stage && stereo_stage->get().pilot_locked(), std::memory_order_relaxed);
+    if (am_stage) {
+        am_gain.store(am_stage->get().gainDb(), std::memory_order_relaxed);
+        carrier.store(am_stage->get().carrierLocked(), std::memory_order_relaxed);
+    }
+
+    gate_audio(abuf[a], n, channel_samples);
+    queue_squelch_events(n, channel_samples);
+    audio_samples += n;
+    active_count.fetch_add(1, std::memory_order_relaxed);
+    demod_time.store(demod_time.load(std::memory_order_relaxed) +
+                     std::chrono::duration<double>(std::chrono::steady_clock::now() - demod_start).count(),
+                     std::memory_order_relaxed);
+    return Span<const float>(abuf[a], n);
+}
+
+size_t DspPipeline::to_stereo(const float *in, size_t n, float *out, size_t out_size) {
+    n = std::min(n, out_size / 2);
+    for (size_t i = 0; i < n; i++) {
+        out[2 * i] = out[2 * i + 1] = in[i];
+    }
+    return n * 2;
+}
+
+void DspPipeline::gate_audio(float *audio, size_t n, size_t channel_samples) {
+    if (!squelch_stage->is_enabled() || channel_samples == 0) {
+        return;
+    }
+
+    // Output silence for the closed windows, mapped from channel to audio
+    // frames so both channels of a stereo frame go together
+    size_t channels = channel.audio.channels;
+    size_t frames = n / channels;
+    const std::vector<uint8_t> &open = squelch_stage->window_open();
+    size_t window = squelch_stage->window_samples();
+    for (size_t i = 0; i < open.size(); i++) {
+        if (open[i]) {
+            continue;
+        }
+        size_t start = i * window * frames / channel_samples;
+        size_t end = std::min((i + 1) * window, channel_samples) * frames / channel_samples;
+        std::fill(audio + start * channels, audio + end * channels, 0.0f);
+    }
+}
+
+void DspPipeline::queue_squelch_events(size_t n, size_t channel_samples) {
+    size_t channels = channel.audio.channels;
+    const std::vector<SquelchEvent> &transitions = squelch_stage->transitions();
+    for (size_t i = 0; i < transitions.size(); i++) {
+        SquelchEvent event = transitions[i];
+        uint64_t offset = event.channel_sample - squelch_stage->block_start();
+        uint64_t frame = channel_samples ? offset * (n / channels) / channel_samples : 0;
+        event.audio_sample = audio_samples + frame * channels;
+        events.write(&event, 1);
+    }
+}
+
+void DspPipeline::reset() {
+    // A retune ends the transmission that was being heard
+    if (squelch_stage->is_enabled() && squelch_stage->is_open()) {
+        SquelchEvent event;
+        event.open = false;
+        event.channel_sample = squelch_stage->block_start();
+        event.audio_sample = audio_samples;
+        event.level_db = squelch_stage->level_db();
+        event.noise_floor_db = squelch_stage->noise_floor_db();
+        events.write(&event, 1);
+    }
+
+    for (size_t i = 0; i < channel_stages.size(); i++) {
+        channel_stages[i]->reset();
+    }
+    if (rds_decoder) {
+        rds_decoder->reset();
+    }
+    demod->reset();
+    for (size_t i = 0; i < audio_stages.size(); i++) {
+        audio_stages[i]->reset();
+    }
+}
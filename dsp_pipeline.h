@@ -0,0 +1,356 @@
+#ifndef _DSP_PIPELINE_H
+#define _DSP_PIPELINE_H
+
+#include <atomic>
+#include <chrono>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <liquid/liquid.h>
+#include "am_demod.h"
+#include "config.h"
+#include "dsp_context.h"
+#include "channelizer.h"
+#include "fm_demod.h"
+#include "iq_convert.h"
+#include "rds.h"
+#include "ringbuffer.h"
+#include "wfm_stereo.h"
+
+// Non-owning view of a contiguous block of samples
+template <typename T>
+struct Span {
+    T *data;
+    size_t size;
+
+    Span() : data(nullptr), size(0) {}
+    Span(T *d, size_t n) : data(d), size(n) {}
+    // Allow Span<T> -> Span<const T>
+    template <typename U>
+    Span(const Span<U> &other) : data(other.data), size(other.size) {}
+
+    T &operator[](size_t i) const { return data[i]; }
+};
+
+// One block-oriented processing step. Each stage owns its filter and
+// demodulator state. 'out' may alias 'in' for stages that work in place.
+template <typename In, typename Out>
+class DspStage {
+    public:
+        virtual ~DspStage() {}
+        virtual const char *name() const = 0;
+
+        // Process in.size input samples, return the number written to out
+        virtual size_t process(Span<const In> in, Span<Out> out) = 0;
+
+        // Drop all filter history, e.g. after a retune
+        virtual void reset() {}
+
+        // Output rate for a given input rate
+        virtual double output_rate(double input_rate) const { return input_rate; }
+};
+
+typedef DspStage<uint8_t, std::complex<float>> InputStage;    // Raw IQ bytes -> complex
+typedef DspStage<std::complex<float>, std::complex<float>> ChannelStage;
+typedef DspStage<std::complex<float>, float> DemodStage;
+typedef DspStage<float, float> AudioStage;
+
+// Interleaved u8 or cf32 I/Q to complex float; in.size is in bytes
+class IqConvertStage : public InputStage {
+    public:
+        explicit IqConvertStage(IqSampleFormat format) : format(format) {}
+        const char *name() const { return "iq_convert"; }
+        size_t process(Span<const uint8_t> in, Span<std::complex<float>> out);
+
+    private:
+        IqSampleFormat format;
+};
+
+// Shifts a channel at offset_hz from the center down to 0 Hz, so several
+// channels can be cut out of one wideband IQ stream
+class MixerStage : public ChannelStage {
+    public:
+        MixerStage(double offset_hz, double sample_rate);
+        ~MixerStage();
+        const char *name() const { return "mixer"; }
+        size_t process(Span<const std::complex<float>> in, Span<std::complex<float>> out);
+        void set_offset(double offset_hz, double sample_rate);
+
+    private:
+        MixerStage(const MixerStage &);
+        MixerStage &operator=(const MixerStage &);
+
+        nco_crcf nco;
+};
+
+class ChannelizerStage : public ChannelStage {
+    public:
+        ChannelizerStage(int input_rate, int min_output_rate, float cutoff_hz);
+        const char *name() const { return "channelizer"; }
+        size_t process(Span<const std::complex<float>> in, Span<std::complex<float>> out);
+        void reset() { channelizer.reset(); }
+        double output_rate(double) const { return channelizer.output_rate(); }
+        const Channelizer &get() const { return channelizer; }
+
+    private:
+        Channelizer channelizer;
+};
+
+// Squelch open/close transition. Timestamps count samples since the
+// pipeline was built, on the channel and in the (interleaved) audio handed
+// to the encoder.
+struct SquelchEvent {
+    bool open;
+    uint64_t channel_sample;
+    uint64_t audio_sample;
+    float level_db;
+    float noise_floor_db;
+};
+
+// Squelch on the decimated channel. Power is measured over short windows
+// and compared with a fixed threshold, or with one riding on a tracked
+// noise floor, with hysteresis and a hold time counted in samples.
+// Samples pass through unchanged; DspPipeline gates the audio with the
+// per-window decisions of the last block.
+class SquelchStage : public ChannelStage {
+    public:
+        SquelchStage(bool enabled, float threshold_db, int hold_ms,
+                     float hysteresis_db, bool adaptive, float snr_db);
+        const char *name() const { return "squelch"; }
+        size_t process(Span<const std::complex<float>> in, Span<std::complex<float>> out);
+        // Close and forget the noise floor, e.g. after a retune
+        void reset();
+        // Channel rate, sets the window and hold lengths. max_block is the
+        // longest block process() will see, so the per-block lists are
+        // reserved here rather than grown on the DSP thread.
+        void set_rate(double rate, size_t max_block);
+
+        void set_enabled(bool on) { enabled = on; }
+        void set_threshold(float db) { threshold_db = db; }
+        bool is_enabled() const { return enabled; }
+        bool is_open() const { return open; }
+        float level_db() const { return level.load(std::memory_order_relaxed); }
+        float noise_floor_db() const { return noise_floor.load(std::memory_order_relaxed); }
+        bool muted() const { return is_muted.load(std::memory_order_relaxed); }
+        // Channel time judged by the squelch, and the part of it spent open
+        double checked_seconds() const { return checked_time.load(std::memory_order_relaxed); }
+        double open_seconds() const { return open_time.load(std::memory_order_relaxed); }
+
+        // Decisions for the last block: open flag per window of
+        // window_samples() channel samples, and the transitions made
+        size_t window_samples() const { return window; }
+        const std::vector<uint8_t> &window_open() const { return windows_open; }
+        const std::vector<SquelchEvent> &transitions() const { return block_events; }
+        uint64_t block_start() const { return block_first_sample; }
+
+    private:
+        void transition(bool to_open, uint64_t sample, float db);
+
+        bool enabled;
+        float threshold_db;
+        int hold_ms;
+        float hysteresis_db;
+        bool adaptive;
+        float snr_db;
+
+        size_t window;            // Samples per decision
+        float window_seconds;
+        uint64_t hold_samples;
+        bool open;
+        bool floor_valid;
+        uint64_t samples;         // Channel samples seen
+        uint64_t last_above;      // Sample index where the level last held up
+        uint64_t block_first_sample;
+        std::vector<uint8_t> windows_open;
+        std::vector<SquelchEvent> block_events;
+
+        std::atomic<float> level;
+        std::atomic<float> noise_floor;
+        std::atomic<bool> is_muted;
+        std::atomic<double> checked_time;
+        std::atomic<double> open_time;
+};
+
+class FmDemodStage : public DemodStage {
+    public:
+        FmDemodStage(ModulationMode mode, double rate, FmDiscriminator disc);
+        const char *name() const { return "fm_demod"; }
+        size_t process(Span<const std::complex<float>> in, Span<float> out);
+        void reset() { demod.reset(); }
+        const FMDemodulator &get() const { return demod; }
+
+    private:
+        FMDemodulator demod;
+};
+
+class AmDemodStage : public DemodStage {
+    public:
+        AmDemodStage(AmDetector detector, double rate, bool agc, float attack_ms, float release_ms);
+        const char *name() const { return "am_demod"; }
+        size_t process(Span<const std::complex<float>> in, Span<float> out);
+        void reset() { demod.reset(); }
+        const AMDemodulator &get() const { return demod; }
+
+    private:
+        AMDemodulator demod;
+};
+
+class ResamplerStage : public AudioStage {
+    public:
+        ResamplerStage(double input_rate, double output_rate);
+        ~ResamplerStage();
+        const char *name() const { return "resampler"; }
+        size_t process(Span<const float> in, Span<float> out);
+        void reset() { msresamp_rrrf_reset(resampler); }
+        double output_rate(double) const { return rate_out; }
+
+    private:
+        ResamplerStage(const ResamplerStage &);
+        ResamplerStage &operator=(const ResamplerStage &);
+
+        msresamp_rrrf resampler;
+        double rate_out;
+};
+
+// Takes the place of the resampler on WFM channels with stereo or RDS:
+// flat multiplex in, interleaved left/right (or mono) at the audio rate out
+class WfmStereoStage : public AudioStage {
+    public:
+        WfmStereoStage(double mpx_rate, int audio_rate, bool stereo, float deemphasis_us, RdsDecoder *rds,
+                       size_t max_block);
+        const char *name() const { return "wfm_stereo"; }
+        size_t process(Span<const float> in, Span<float> out);
+        void reset() { decoder.reset(); }
+        double output_rate(double) const { return rate_out; }
+        const WfmStereoDecoder &get() const { return decoder; }
+
+    private:
+        WfmStereoDecoder decoder;
+        double rate_out;
+};
+
+// WFM de-emphasis at the audio rate, on the mono path without the stereo decoder
+class DeemphasisStage : public AudioStage {
+    public:
+        DeemphasisStage(float time_constant_us, int audio_rate) { filter.set(time_constant_us, audio_rate); }
+        const char *name() const { return "deemphasis"; }
+        size_t process(Span<const float> in, Span<float> out);
+        void reset() { filter.reset(); }
+
+    private:
+        Deemphasis filter;
+};
+
+// Butterworth high-pass on the audio, removes e.g. CTCSS tones. One
+// filter per channel of interleaved audio.
+class LowCutStage : public AudioStage {
+    public:
+        LowCutStage(float cutoff_hz, int order, int audio_rate, int channels);
+        ~LowCutStage();
+        const char *name() const { return "lowcut"; }
+        size_t process(Span<const float> in, Span<float> out);
+        void reset();
+
+    private:
+        LowCutStage(const LowCutStage &);
+        LowCutStage &operator=(const LowCutStage &);
+
+        std::vector<iirfilt_rrrf> filters;
+};
+
+// Complete receive chain from raw IQ bytes to audio at the channel's
+// audio rate for one channel, interleaved when the channel is stereo.
+// Built from Config and the channel's own offset, mode and squelch;
+// stages run in the order of the vectors below and can be rearranged
+// between blocks by the owning thread.
+class DspPipeline {
+    public:
+        DspPipeline(const Config &config, const ChannelConfig &channel, size_t max_block_bytes,
+                    IqSampleFormat format);
+
+        // Rebuild the mode dependent stages (channel filter, demod, resampler)
+        void set_mode(ModulationMode mode);
+        // Rebuild the audio stages (resampler and de-emphasis or stereo
+        // decoder, low-cut)
+        void set_lowcut(bool enabled, float freq, int order);
+        // Move the channel to offset_hz from the center frequency
+        void set_offset(double offset_hz);
+
+        // Run one block of raw IQ, 'len' bytes in the input's sample
+        // format; the returned audio stays valid until the next call
+        Span<const float> process(const uint8_t *iq, size_t len);
+
+        void reset();
+
+        ModulationMode mode() const { return current_mode.load(); }
+        double offset() const { return current_offset.load(); }
+        double channel_rate() const { return chan_rate; }
+        int audio_rate() const { return audio_out_rate; }
+        float signal_db() const { return squelch_stage->level_db(); }
+        bool squelched() const { return squelch_stage->muted(); }
+        int audio_channels() const { return channel.audio.channels; }
+        // Stereo pilot found in the last block
+        bool pilot_locked() const { return pilot.load(std::memory_order_relaxed); }
+        // AM gain of the last block, and whether the sync detector's PLL
+        // holds the carrier
+        float am_gain_db() const { return am_gain.load(std::memory_order_relaxed); }
+        bool carrier_locked() const { return carrier.load(std::memory_order_relaxed); }
+        // Null unless RDS decoding is enabled
+        const RdsDecoder *rds() const { return rds_decoder.get(); }
+        SquelchStage *squelch() { return squelch_stage; }
+        const DspContext &context() const { return ctx; }
+        // Squelch transitions, written by the thread running process()
+        SpscRingBuffer<SquelchEvent> &squelch_events() { return events; }
+
+        // Blocks demodulated, and blocks skipped because the squelch was
+        // closed throughout; demod_seconds() is the time spent on the former
+        uint64_t active_blocks() const { return active_count.load(std::memory_order_relaxed); }
+        uint64_t idle_blocks() const { return idle_count.load(std::memory_order_relaxed); }
+        double demod_seconds() const { return demod_time.load(std::memory_order_relaxed); }
+
+        std::unique_ptr<InputStage> input;
+        std::vector<std::unique_ptr<ChannelStage>> channel_stages;
+        std::unique_ptr<DemodStage> demod;
+        std::vector<std::unique_ptr<AudioStage>> audio_stages;
+
+    private:
+        DspPipeline(const DspPipeline &);
+        DspPipeline &operator=(const DspPipeline &);
+
+        // Upper bound of a block at the channel rate
+        size_t max_channel_samples() const;
+        // Copy mono audio into both channels of a stereo stream
+        size_t to_stereo(const float *in, size_t n, float *out, size_t out_size);
+        // Zero the audio of closed squelch windows
+        void gate_audio(float *audio, size_t n, size_t channel_samples);
+        // Queue the squelch transitions of the block, n audio samples long
+        void queue_squelch_events(size_t n, size_t channel_samples);
+
+        const Config &config;
+        ChannelConfig channel;
+        size_t sample_bytes;          // Per raw I/Q sample
+        DspContext ctx;
+        MixerStage *mixer_stage;      // Owned by channel_stages, null at 0 Hz offset
+        SquelchStage *squelch_stage;  // Owned by channel_stages
+        WfmStereoStage *stereo_stage; // Owned by audio_stages, null unless WFM with stereo or RDS
+        AmDemodStage *am_stage;       // Owned by demod, null unless AM
+        std::unique_ptr<RdsDecoder> rds_decoder;  // Kept across mode changes, read by other threads
+        std::atomic<ModulationMode> current_mode;
+        std::atomic<double> current_offset;
+        double chan_rate;
+        int audio_out_rate;
+        uint64_t audio_samples;  // Audio samples produced so far, interleaved
+        double idle_audio;       // Fractional audio samples owed by skipped blocks
+        bool was_idle;           // Demod and audio stages hold stale history
+        std::atomic<uint64_t> active_count;
+        std::atomic<uint64_t> idle_count;
+        std::atomic<double> demod_time;
+        std::atomic<bool> pilot;
+        std::atomic<float> am_gain;
+        std::atomic<bool> carrier;
+        SpscRingBuffer<SquelchEvent> events;
+};
+
+#endif // _DSP_PIPELINE_H
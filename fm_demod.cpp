@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cmath>
+#include "fm_demod.h"
+
+#define FM_DEFAULT_SAMPLE_RATE 1024000.0f
+#define FM_DISC_CHUNK 64
+#define FM_DC_BLOCK_HZ 20.0f       // DC blocker corner, below any audio
+
+FmDiscriminator fm_discriminator_parse(const std::string &name) {
+    if (name == "exact") return FmDiscriminator::EXACT;
+    return FmDiscriminator::FAST;
+}
+
+const char *fm_discriminator_name(FmDiscriminator disc) {
+    return (disc == FmDiscriminator::EXACT) ? "exact" : "fast";
+}
+
+float fast_atan2(float y, float x) {
+    const float pi = static_cast<float>(M_PI);
+    float ax = std::fabs(x);
+    float ay = std::fabs(y);
+    float mn = std::min(ax, ay);
+    float mx = std::max(ax, ay);
+    float a = mn / (mx + 1e-30f);
+
+    // Minimax polynomial for atan(a), a in [0, 1]
+    float s = a * a;
+    float r = a * (0.99997726f + s * (-0.33262347f + s * (0.19354346f +
+              s * (-0.11643287f + s * (0.05265332f + s * -0.01172120f)))));
+
+    // Map back from the first octant
+    r = (ay > ax) ? (pi / 2.0f - r) : r;
+    r = (x < 0.0f) ? (pi - r) : r;
+    return (y < 0.0f) ? -r : r;
+}
+
+FMDemodulator::FMDemodulator() :
+    prev_sample(1.0f, 0.0f),
+    dc_alpha(0.0f),
+    dc_avg(0.0f),
+    deviation(WFM_DEVIATION),
+    sample_rate(FM_DEFAULT_SAMPLE_RATE),
+    discriminator(FmDiscriminator::FAST) {
+    setMode(ModulationMode::WFM_MODE, sample_rate);
+}
+
+void FMDemodulator::setMode(ModulationMode mode, float sampleRate) {
+    deviation = (mode == ModulationMode::WFM_MODE) ? WFM_DEVIATION : NFM_DEVIATION;
+    sample_rate = sampleRate;
+    dc_alpha = 1.0f - expf(-2.0f * static_cast<float>(M_PI) * FM_DC_BLOCK_HZ * FM_DISC_CHUNK / sample_rate);
+}
+
+void FMDemodulator::reset() {
+    prev_sample = std::complex<float>(1.0f, 0.0f);
+    dc_avg = 0.0f;
+}
+
+float FMDemodulator::demodulate(std::complex<float> sample) {
+    float demod;
+    demodulate(&sample, &demod, 1);
+    return demod;
+}
+
+void FMDemodulator::discriminate(const std::complex<float> *in, float *out, size_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    // arg() of the conjugate product is already bounded to [-pi, pi], so
+    // no unwrapping is needed
+    std::complex<float> d = in[0] * std::conj(prev_sample);
+    out[0] = (discriminator == FmDiscriminator::EXACT) ? std::arg(d) : fast_atan2(d.imag(), d.real());
+
+    const float *x = reinterpret_cast<const float *>(in);
+    if (discriminator == FmDiscriminator::EXACT) {
+        for (size_t i = 1; i < count; i++) {
+            out[i] = std::arg(in[i] * std::conj(in[i - 1]));
+        }
+    } else {
+        // Work in short chunks with the conjugate products deinterleaved
+        // into contiguous arrays, so the branchless atan2 loop vectorizes
+        float re[FM_DISC_CHUNK];
+        float im[FM_DISC_CHUNK];
+        for (size_t base = 1; base < count; base += FM_DISC_CHUNK) {
+            size_t n = std::min<size_t>(FM_DISC_CHUNK, count - base);
+            for (size_t k = 0; k < n; k++) {
+                size_t i = base + k;
+                re[k] = x[2 * i] * x[2 * i - 2] + x[2 * i + 1] * x[2 * i - 1];
+                im[k] = x[2 * i + 1] * x[2 * i - 2] - x[2 * i] * x[2 * i - 1];
+            }
+            for (size_t k = 0; k < n; k++) {
+                out[base + k] = fast_atan2(im[k], re[k]);
+            }
+        }
+    }
+    prev_sample = in[count - 1];
+}
+
+void FMDemodulator::demodulate(const std::complex<float> *in, float *out, size_t count) {
+    discriminate(in, out, count);
+
+    // Scale phase to audio and remove the DC left by a mistuned carrier.
+    // The average moves once per chunk, far faster than its corner, so
+    // the inner loops are plain multiply-adds and vectorize
+    const float scale = sample_rate / (2.0f * M_PI * deviation);
+    float avg = dc_avg;
+    for (size_t base = 0; base < count; base += FM_DISC_CHUNK) {
+        size_t n = std::min<size_t>(FM_DISC_CHUNK, count - base);
+        float *x = out + base;
+        float sum = 0.0f;
+        for (size_t k = 0; k < n; k++) {
+            x[k] *= scale;
+            sum += x[k];
+        }
+        for (size_t k = 0; k < n; k++) {
+            x[k] -= avg;
+        }
+        avg += dc_alpha * (n / static_cast<float>(FM_DISC_CHUNK)) * (sum / n - avg);
+    }
+    dc_avg = avg;
+}
+
+void Deemphasis::set(float time_constant_us, double rate) {
+    alpha = (time_constant_us > 0.0f) ?
+        static_cast<float>(1.0 - std::exp(-1.0 / (time_constant_us * 1e-6 * rate))) : 1.0f;
+    state = 0.0f;
+}
+
+void Deemphasis::process(float *x, size_t count, size_t stride) {
+    if (!enabled()) {
+        return;
+    }
+    // The recursion is serial, so keep the state in a register
+    float y = state;
+    const float a = alpha;
+    for (size_t i = 0; i < count; i++) {
+        y += a * (x[i * stride] - y);
+        x[i * stride] = y;
+    }
+    state = y;
+}
@@ -0,0 +1,72 @@
+#ifndef _FM_DEMOD_H
+#define _FM_DEMOD_H
+
+#include <complex>
+#include <cstddef>
+#include <string>
+#include "config.h"
+
+#define NFM_DEVIATION 12500
+#define WFM_DEVIATION 75000   // 75 kHz for WBFM
+
+// Phase discriminator used by the FM demodulator
+enum class FmDiscriminator {
+    EXACT,  // std::arg, full-precision atan2
+    FAST    // Branchless polynomial atan2, vectorizes across a block
+};
+
+FmDiscriminator fm_discriminator_parse(const std::string &name);
+const char *fm_discriminator_name(FmDiscriminator disc);
+
+// Polynomial atan2 approximation, max error about 2e-6 rad
+float fast_atan2(float y, float x);
+
+// FM demodulator with DC blocking. The output is the flat (not
+// de-emphasized) audio or multiplex at the input rate; de-emphasis runs
+// after decimation, see Deemphasis.
+class FMDemodulator {
+    private:
+        std::complex<float> prev_sample;
+        float dc_alpha;        // DC average update per chunk
+        float dc_avg;
+        float deviation;
+        float sample_rate;
+        FmDiscriminator discriminator;
+
+        // Phase of in[i] * conj(in[i-1]) for a block, written to 'out'
+        void discriminate(const std::complex<float> *in, float *out, size_t count);
+
+    public:
+        FMDemodulator();
+
+        void setMode(ModulationMode mode, float sampleRate);
+        void setDiscriminator(FmDiscriminator disc) { discriminator = disc; }
+        FmDiscriminator getDiscriminator() const { return discriminator; }
+        void reset();
+
+        float demodulate(std::complex<float> sample);
+
+        // Demodulate a block of 'count' samples; 'out' may not alias 'in'
+        void demodulate(const std::complex<float> *in, float *out, size_t count);
+};
+
+// Broadcast FM de-emphasis, a one-pole low-pass with the region's time
+// constant (75 us in the Americas and Korea, 50 us elsewhere). Runs at
+// the audio rate; a time constant of 0 passes the audio unchanged.
+class Deemphasis {
+    public:
+        Deemphasis() : alpha(1.0f), state(0.0f) {}
+
+        void set(float time_constant_us, double rate);
+        bool enabled() const { return alpha < 1.0f; }
+        void reset() { state = 0.0f; }
+
+        // Filter every 'stride'-th sample of 'x' in place, 'count' samples
+        void process(float *x, size_t count, size_t stride = 1);
+
+    private:
+        float alpha;
+        float state;
+};
+
+#endif // _FM_DEMOD_H
@@ -0,0 +1,329 @@
+#include <iostream>
+#include <cstdio>
+#include "icecast_sender.h"
+
+#define ICECAST_CONNECT_TIMEOUT_S 10  // Give up on a connect attempt after this
+#ifndef ICECAST_STALL_TIMEOUT_S       // The tools/test build shortens it
+#define ICECAST_STALL_TIMEOUT_S 15    // Reconnect if the socket accepts nothing for this long
+#endif
+#define ICECAST_LONG_RETRY_S 30       // Pause after reconnect_attempts failures in a row
+#define ICECAST_PACING_LEAD_MS 1000   // How far ahead of real time the stream may run
+#define ICECAST_POLL_MS 10            // Recheck interval while libshout has bytes pending
+
+static int64_t steady_ms(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(t.time_since_epoch()).count();
+}
+
+IcecastSender::IcecastSender(const IcecastTarget &target, Mp3FrameQueue &queue) :
+    config(target),
+    queue(queue),
+    shout(nullptr),
+    current_state(IDLE),
+    broken(false),
+    failed_attempts(0),
+    ever_connected(false),
+    next_attempt_ms(0),
+    stream_seconds(0.0),
+    bytes_per_second(target.bitrate_kbps * 1000.0 / 8.0),
+    header_sent(false),
+    pending_bytes(0),
+    frame(nullptr),
+    queue_latency(nullptr),
+    total_latency(nullptr),
+    sent_bytes(0),
+    reconnect_count(0),
+    discarded_frames(0),
+    last_size(0)
+{
+}
+
+IcecastSender::~IcecastSender() {
+    if (frame) {
+        queue.release(frame);
+    }
+    if (shout) {
+        shout_close(shout);
+        shout_free(shout);
+    }
+}
+
+void IcecastSender::set_state(State state) {
+    current_state.store(state, std::memory_order_relaxed);
+}
+
+void IcecastSender::start_connect() {
+    if (ever_connected || failed_attempts > 0) {
+        reconnect_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    shout = shout_new();
+    if (!shout) {
+        connection_failed("failed to create new shout instance");
+        return;
+    }
+    
+    shout_set_host(shout, config.host.c_str());
+    shout_set_port(shout, config.port);
+    shout_set_mount(shout, config.mount.c_str());
+    shout_set_user(shout, config.user.c_str());
+    shout_set_password(shout, config.password.c_str());
+    shout_set_format(shout, config.format);
+    shout_set_protocol(shout, SHOUT_PROTOCOL_HTTP);
+    shout_set_name(shout, config.name.c_str());
+    shout_set_nonblocking(shout, 1);
+    
+    printf("Connecting to Icecast server %s:%d%s...\n",
+           config.host.c_str(), config.port, config.mount.c_str());
+    
+    connect_started = std::chrono::steady_clock::now();
+    broken.store(false, std::memory_order_relaxed);
+    int err = shout_open(shout);
+    if (err == SHOUTERR_SUCCESS || err == SHOUTERR_BUSY) {
+        set_state(CONNECTING);
+        check_connect();
+    } else {
+        connection_failed(shout_get_error(shout));
+    }
+}
+
+// CONNECTING: libshout finishes the connect and login in the background
+void IcecastSender::check_connect() {
+    int err = shout_get_connected(shout);
+    if (err == SHOUTERR_CONNECTED) {
+        std::cout << "Successfully connected to Icecast " << config.mount << "\n";
+        set_state(CONNECTED);
+        ever_connected = true;
+        failed_attempts = 0;
+        stream_start = std::chrono::steady_clock::now();
+        stream_seconds = 0.0;
+        header_sent = config.header.empty();
+        pending_bytes = 0;
+        last_progress = stream_start;
+    } else if (err != SHOUTERR_BUSY) {
+        connection_failed(shout_get_error(shout));
+    } else if (std::chrono::steady_clock::now() - connect_started > std::chrono::seconds(ICECAST_CONNECT_TIMEOUT_S)) {
+        connection_failed("timed out");
+    }
+}
+
+// A connect attempt failed: retry after reconnect_delay_ms, or pause
+// longer after too many failures in a row
+void IcecastSender::connection_failed(const std::string &why) {
+    std::cerr << "Failed to connect to Icecast " << config.mount << ": " << why << std::endl;
+    if (shout) {
+        shout_close(shout);
+        shout_free(shout);
+        shout = nullptr;
+    }
+    
+    failed_attempts++;
+    auto now = std::chrono::steady_clock::now();
+    if (failed_attempts < config.reconnect_attempts) {
+        std::cout << "Reconnection attempt " << failed_attempts
+                  << " of " << config.reconnect_attempts << " failed\n";
+        next_attempt = now + std::chrono::milliseconds(config.reconnect_delay_ms);
+    } else {
+        std::cerr << "Failed to reconnect after " << config.reconnect_attempts
+                  << " attempts, waiting longer...\n";
+        next_attempt = now + std::chrono::seconds(ICECAST_LONG_RETRY_S);
+        failed_attempts = 0;
+    }
+    next_attempt_ms.store(steady_ms(next_attempt), std::memory_order_relaxed);
+    set_state(BACKOFF);
+}
+
+// The connection was up and went away: reconnect at once
+void IcecastSender::disconnect(const std::string &why) {
+    std::cerr << "Icecast connection lost on " << config.mount << ": " << why << std::endl;
+    if (shout) {
+        shout_close(shout);
+        shout_free(shout);
+        shout = nullptr;
+    }
+    next_attempt = std::chrono::steady_clock::now();
+    next_attempt_ms.store(steady_ms(next_attempt), std::memory_order_relaxed);
+    set_state(BACKOFF);
+}
+
+// While disconnected, keep only what the pacing lead would send as a
+// burst after reconnecting, so the encoder never runs into a full queue
+// and listeners get current audio. With the block policy nothing may be
+// lost, so the queue is left alone.
+void IcecastSender::discard_backlog() {
+    if (queue.policy() == Mp3Overflow::BLOCK) {
+        return;
+    }
+    size_t keep = static_cast<size_t>(bytes_per_second * ICECAST_PACING_LEAD_MS / 1000);
+    while (queue.bytes() > keep) {
+        Mp3FrameQueue::Frame *oldest = queue.claim();
+        if (!oldest) {
+            break;
+        }
+        queue.release(oldest);
+        discarded_frames.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// CONNECTED: hand frames to libshout as long as it keeps up and the
+// stream stays within the pacing lead
+std::chrono::milliseconds IcecastSender::send_frames() {
+    auto now = std::chrono::steady_clock::now();
+    
+    // Push out what libshout still buffers before adding more
+    if (pending_bytes > 0) {
+        int err = shout_send(shout, reinterpret_cast<const unsigned char *>(""), 0);
+        if (err != SHOUTERR_SUCCESS && err != SHOUTERR_BUSY) {
+            disconnect(shout_get_error(shout));
+            return std::chrono::milliseconds(0);
+        }
+        ssize_t pending = shout_queuelen(shout);
+        if (pending < pending_bytes) {
+            last_progress = now;
+        }
+        pending_bytes = pending;
+        if (pending_bytes > 0) {
+            if (now - last_progress > std::chrono::seconds(ICECAST_STALL_TIMEOUT_S)) {
+                disconnect("server stopped reading");
+                return std::chrono::milliseconds(0);
+            }
+            return std::chrono::milliseconds(ICECAST_POLL_MS);
+        }
+    }
+    
+    // A new Ogg stream has to open with the codec headers
+    if (!header_sent) {
+        int err = shout_send(shout, config.header.data(), config.header.size());
+        if (err != SHOUTERR_SUCCESS && err != SHOUTERR_BUSY) {
+            disconnect(shout_get_error(shout));
+            return std::chrono::milliseconds(0);
+        }
+        header_sent = true;
+        sent_bytes.fetch_add(config.header.size(), std::memory_order_relaxed);
+        pending_bytes = shout_queuelen(shout);
+        if (pending_bytes > 0) {
+            last_progress = now;
+            return std::chrono::milliseconds(ICECAST_POLL_MS);
+        }
+    }
+    
+    while (true) {
+        // Pacing on the audio time sent, whatever the container adds
+        double ahead = stream_seconds -
+                       std::chrono::duration<double>(now - stream_start).count();
+        double lead = ICECAST_PACING_LEAD_MS / 1000.0;
+        if (ahead > lead) {
+            return std::chrono::milliseconds(static_cast<int64_t>((ahead - lead) * 1000) + 1);
+        }
+        
+        if (!frame) {
+            frame = queue.claim();
+            if (!frame) {
+                return std::chrono::milliseconds::max();
+            }
+        }
+        
+        last_size.store(frame->size, std::memory_order_relaxed);
+        if (queue_latency) {
+            queue_latency->record(now - frame->queued);
+        }
+        int err = shout_send(shout, frame->data, frame->size);
+        if (err != SHOUTERR_SUCCESS && err != SHOUTERR_BUSY) {
+            // Keep the frame and send it after reconnecting
+            disconnect(shout_get_error(shout));
+            return std::chrono::milliseconds(0);
+        }
+        
+        // libshout copies what the socket does not take
+        if (total_latency) {
+            total_latency->record(std::chrono::steady_clock::now() - frame->arrival);
+        }
+        sent_bytes.fetch_add(frame->size, std::memory_order_relaxed);
+        stream_seconds += frame->duration;
+        queue.release(frame);
+        frame = nullptr;
+        
+        pending_bytes = shout_queuelen(shout);
+        if (pending_bytes > 0) {
+            last_progress = now;
+            return std::chrono::milliseconds(ICECAST_POLL_MS);
+        }
+    }
+}
+
+std::chrono::milliseconds IcecastSender::run_once() {
+    if (broken.exchange(false, std::memory_order_relaxed) && state() == CONNECTED) {
+        disconnect("broken pipe");
+    }
+    
+    switch (state()) {
+        case IDLE:
+            start_connect();
+            break;
+        case BACKOFF:
+            if (std::chrono::steady_clock::now() >= next_attempt) {
+                start_connect();
+            }
+            break;
+        case CONNECTING:
+            check_connect();
+            break;
+        case CONNECTED:
+            if (shout_get_connected(shout) != SHOUTERR_CONNECTED) {
+                disconnect(shout_get_error(shout));
+                break;
+            }
+            return send_frames();
+    }
+    
+    if (state() == CONNECTED) {
+        return std::chrono::milliseconds(0);
+    }
+    discard_backlog();
+    if (state() == BACKOFF) {
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next_attempt - std::chrono::steady_clock::now());
+        return std::max(wait, std::chrono::milliseconds(0));
+    }
+    return std::chrono::milliseconds(ICECAST_POLL_MS);
+}
+
+bool IcecastSender::set_metadata(const std::string &artist, const std::string &title) {
+    if (!connected()) {
+        return false;
+    }
+    
+    shout_metadata_t *metadata = shout_metadata_new();
+    if (!metadata) {
+        std::cerr << "Failed to create metadata object" << std::endl;
+        return false;
+    }
+    
+    int ret_artist = shout_metadata_add(metadata, "artist", artist.c_str());
+    int ret_title = shout_metadata_add(metadata, "title", title.c_str());
+    if (ret_artist != SHOUTERR_SUCCESS || ret_title != SHOUTERR_SUCCESS) {
+        std::cerr << "Error adding metadata fields" << std::endl;
+        shout_metadata_free(metadata);
+        return false;
+    }
+    
+    int result = shout_set_metadata(shout, metadata);
+    shout_metadata_free(metadata);
+    if (result != SHOUTERR_SUCCESS) {
+        std::cerr << "Error updating metadata: " << shout_get_error(shout) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::string IcecastSender::status_text() const {
+    switch (state()) {
+        case CONNECTED:
+            return "Connected";
+        case CONNECTING:
+            return "Connecting";
+        case BACKOFF: {
+            int64_t wait = next_attempt_ms.load(std::memory_order_relaxed) - steady_ms(std::chrono::steady_clock::now());
+            return "Disconnected, retry in " + std::to_string(std::max<int64_t>(wait, 0) / 1000) + "s";
+        }
+        default:
+            return "Disconnected";
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef _ICECAST_SENDER_H
+#define _ICECAST_SENDER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <shout/shout.h>
+#include "mp3_queue.h"
+#include "latency.h"
+
+// Where and how to publish one stream
+struct IcecastTarget {
+    std::string host;
+    int port;
+    std::string mount;
+    std::string user;
+    std::string password;
+    std::string name;          // Station name shown by the server
+    unsigned int format;       // SHOUT_FORMAT_MP3 or SHOUT_FORMAT_OGG
+    std::vector<unsigned char> header;  // Sent first on every connection (Ogg headers)
+    int bitrate_kbps;          // Nominal stream bitrate, sizes the backlog kept while disconnected
+    int reconnect_attempts;    // Quick retries before a long pause
+    int reconnect_delay_ms;
+};
+
+// Streams the frames of one queue to one Icecast mount without ever blocking
+// its thread. libshout runs in nonblocking mode, connecting and backing
+// off between attempts are states polled by run_once(), and frames are
+// paced by the audio time they carry instead of by shout_sync(), so
+// container overhead (an Ogg page per short Opus chunk) does not slow
+// the stream down. One thread drives it; the counters may be read anywhere.
+class IcecastSender {
+    public:
+        enum State { IDLE, CONNECTING, CONNECTED, BACKOFF };
+
+        IcecastSender(const IcecastTarget &target, Mp3FrameQueue &queue);
+        ~IcecastSender();
+
+        // Do whatever is due: connect, send frames the pacing allows,
+        // notice a dead or stalled connection. Returns how long the
+        // caller may wait for new frames before calling again.
+        std::chrono::milliseconds run_once();
+
+        // Artist and title shown by the server, while connected. libshout
+        // sends these over a separate, blocking admin request.
+        bool set_metadata(const std::string &artist, const std::string &title);
+
+        // Record how long frames waited in the queue and how old their
+        // first sample is when handed to libshout; either may be null
+        void set_latency(LatencyHistogram *queued, LatencyHistogram *total) {
+            queue_latency = queued;
+            total_latency = total;
+        }
+
+        // Async-signal-safe: treat the connection as lost, e.g. on SIGPIPE
+        void mark_broken() { broken.store(true, std::memory_order_relaxed); }
+
+        State state() const { return static_cast<State>(current_state.load(std::memory_order_relaxed)); }
+        bool connected() const { return state() == CONNECTED; }
+        const IcecastTarget &target() const { return config; }
+        // "Connected", "Connecting", "Retry in 12s", ...
+        std::string status_text() const;
+
+        uint64_t bytes_sent() const { return sent_bytes.load(std::memory_order_relaxed); }
+        uint64_t reconnects() const { return reconnect_count.load(std::memory_order_relaxed); }
+        uint64_t discarded() const { return discarded_frames.load(std::memory_order_relaxed); }
+        size_t last_frame_size() const { return last_size.load(std::memory_order_relaxed); }
+
+    private:
+        IcecastSender(const IcecastSender &);
+        IcecastSender &operator=(const IcecastSender &);
+
+        void start_connect();
+        void check_connect();
+        void connection_failed(const std::string &why);
+        void disconnect(const std::string &why);
+        std::chrono::milliseconds send_frames();
+        void discard_backlog();
+        void set_state(State state);
+
+        IcecastTarget config;
+        Mp3FrameQueue &queue;
+        shout_t *shout;
+        std::atomic<int> current_state;
+        std::atomic<bool> broken;
+        int failed_attempts;                 // Since the last successful connect
+        bool ever_connected;
+        std::chrono::steady_clock::time_point connect_started;
+        std::chrono::steady_clock::time_point next_attempt;
+        std::atomic<int64_t> next_attempt_ms;  // For status_text(), steady clock ms
+
+        // Pacing: audio time sent since connecting, against the wall clock
+        std::chrono::steady_clock::time_point stream_start;
+        double stream_seconds;
+        double bytes_per_second;             // Nominal, for discard_backlog()
+
+        bool header_sent;                    // On the current connection
+        // Bytes libshout has not written to the socket yet
+        ssize_t pending_bytes;
+        std::chrono::steady_clock::time_point last_progress;
+
+        Mp3FrameQueue::Frame *frame;         // Claimed, not accepted by libshout yet
+        LatencyHistogram *queue_latency;
+        LatencyHistogram *total_latency;
+
+        std::atomic<uint64_t> sent_bytes;
+        std::atomic<uint64_t> reconnect_count;
+        std::atomic<uint64_t> discarded_frames;
+        std::atomic<size_t> last_size;
+};
+
+#endif // _ICECAST_SENDER_H
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "input_source.h"
+
+RtlSdrSource::RtlSdrSource(const Config &config) :
+    config(config),
+    dev(nullptr)
+{
+}
+
+RtlSdrSource::~RtlSdrSource() {
+    if (dev) {
+        rtlsdr_close(dev);
+    }
+}
+
+bool RtlSdrSource::open() {
+    if (rtlsdr_open(&dev, 0) < 0) {
+        std::cerr << "Failed to open RTL-SDR device\n";
+        dev = nullptr;
+        return false;
+    }
+    
+    // Convert MHz to Hz for the RTL-SDR API
+    uint32_t freq_hz = static_cast<uint32_t>(config.center_freq * 1e6);
+    
+    // Apply PPM correction if specified
+    if (config.ppm_correction != 0) {
+        printf("Setting frequency correction to %d ppm\n", config.ppm_correction);
+        rtlsdr_set_freq_correction(dev, config.ppm_correction);
+    }
+    
+    rtlsdr_set_center_freq(dev, freq_hz); 
+    rtlsdr_set_sample_rate(dev, config.sample_rate);
+    rtlsdr_set_tuner_gain_mode(dev, config.gain_mode);
+    if (config.gain_mode == 1) {
+        
+        int tuner_gains[16];
+        int num_gains = rtlsdr_get_tuner_gains(dev, tuner_gains);
+        printf("Allowed gain setting values (1/10 dB): ");
+        for (int i = 0; i < num_gains; i++) {
+            printf("%d ", tuner_gains[i]);
+        }
+        printf("\n");   
+        
+        // Set the specified gain or use a default if not specified
+        int gain_to_use = config.tuner_gain;
+        if (gain_to_use == 0) {
+            // Default to 9.0 dB (90 tenths of a dB) if not specified
+            gain_to_use = 90;
+            printf("No specific gain value provided, using default: %d.%d dB\n", gain_to_use/10, gain_to_use%10);
+        } else {
+            printf("Setting tuner gain to %d.%d dB\n", gain_to_use/10, gain_to_use%10);
+        }
+        
+        rtlsdr_set_tuner_gain(dev, gain_to_use);
+    }
+    rtlsdr_reset_buffer(dev);
+    return true;
+}
+
+bool RtlSdrSource::run(IqBlockCallback cb, void *ctx, uint32_t block_size) {
+    if (rtlsdr_read_async(dev, cb, ctx, 0, block_size) < 0) {
+        std::cerr << "Failed to start async reading\n";
+        return false;
+    }
+    return true;
+}
+
+void RtlSdrSource::stop() {
+    if (dev) {
+        rtlsdr_cancel_async(dev);  // Stop async reading
+    }
+}
+
+bool RtlSdrSource::set_center_freq(uint32_t freq_hz) {
+    return dev && rtlsdr_set_center_freq(dev, freq_hz) >= 0;
+}
+
+uint32_t RtlSdrSource::center_freq() const {
+    return dev ? rtlsdr_get_center_freq(dev) : 0;
+}
+
+IqFileFormat iq_file_format_parse(const std::string &name) {
+    if (name == "cu8" || name == "u8") return IqFileFormat::CU8;
+    if (name == "cf32" || name == "cf32_le" || name == "fc32") return IqFileFormat::CF32;
+    if (name == "sigmf") return IqFileFormat::SIGMF;
+    return IqFileFormat::AUTO;
+}
+
+static bool ends_with(const std::string &str, const std::string &suffix) {
+    return str.size() >= suffix.size() &&
+           str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Value of the first "key": value pair in a JSON document, without quotes.
+// Enough for the flat core: fields of a SigMF meta file.
+static std::string json_value(const std::string &json, const std::string &key) {
+    size_t pos = json.find("\"" + key + "\"");
+    if (pos == std::string::npos) return "";
+    pos = json.find(':', pos);
+    if (pos == std::string::npos) return "";
+    pos = json.find_first_not_of(" \t\r\n", pos + 1);
+    if (pos == std::string::npos) return "";
+    if (json[pos] == '"') {
+        size_t end = json.find('"', pos + 1);
+        return (end == std::string::npos) ? "" : json.substr(pos + 1, end - pos - 1);
+    }
+    size_t end = json.find_first_of(",}] \t\r\n", pos);
+    return json.substr(pos, end - pos);
+}
+
+IqFileSource::IqFileSource(const Config &config) :
+    path(config.input_file),
+    format(iq_file_format_parse(config.input_format)),
+    realtime(config.input_realtime),
+    rate(config.sample_rate),
+    freq_hz(static_cast<uint32_t>(config.center_freq * 1e6)),
+    fd(-1),
+    map(nullptr),
+    map_len(0),
+    stopping(false),
+    done(false),
+    delivered(0)
+{
+}
+
+IqFileSource::~IqFileSource() {
+    if (map) {
+        munmap(const_cast<uint8_t *>(map), map_len);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool IqFileSource::read_sigmf_meta(const std::string &meta_path) {
+    std::ifstream file(meta_path);
+    if (!file.is_open()) {
+        std::cerr << "Could not open SigMF metadata: " << meta_path << std::endl;
+        return false;
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    std::string json = ss.str();
+
+    std::string datatype = json_value(json, "core:datatype");
+    if (datatype == "cu8") {
+        format = IqFileFormat::CU8;
+    } else if (datatype == "cf32_le") {
+        format = IqFileFormat::CF32;
+    } else {
+        std::cerr << "Unsupported SigMF datatype '" << datatype << "' (cu8 and cf32_le are supported)\n";
+        return false;
+    }
+
+    std::string sr = json_value(json, "core:sample_rate");
+    if (!sr.empty()) {
+        rate = static_cast<int>(std::atof(sr.c_str()));
+    }
+    std::string freq = json_value(json, "core:frequency");
+    if (!freq.empty()) {
+        freq_hz = static_cast<uint32_t>(std::atof(freq.c_str()));
+    }
+    return true;
+}
+
+bool IqFileSource::open() {
+    std::string data_path = path;
+
+    // Pick the format from the file name unless configured
+    if (format == IqFileFormat::AUTO) {
+        if (ends_with(path, ".sigmf-meta") || ends_with(path, ".sigmf-data") || ends_with(path, ".sigmf")) {
+            format = IqFileFormat::SIGMF;
+        } else if (ends_with(path, ".cf32") || ends_with(path, ".cfile") || ends_with(path, ".fc32")) {
+            format = IqFileFormat::CF32;
+        } else {
+            format = IqFileFormat::CU8;
+        }
+    }
+
+    if (format == IqFileFormat::SIGMF) {
+        std::string base = path;
+        if (ends_with(base, "-meta") || ends_with(base, "-data")) {
+            base = base.substr(0, base.size() - 5);
+        }
+        if (ends_with(base, ".sigmf")) {
+            base = base.substr(0, base.size() - 6);
+        }
+        if (!read_sigmf_meta(base + ".sigmf-meta")) {
+            return false;
+        }
+        data_path = base + ".sigmf-data";
+    }
+
+    fd = ::open(data_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open IQ file " << data_path << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        std::cerr << "IQ file " << data_path << " is empty or unreadable\n";
+        return false;
+    }
+    map_len = static_cast<size_t>(st.st_size);
+    void *ptr = mmap(nullptr, map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ptr == MAP_FAILED) {
+        std::cerr << "Failed to mmap IQ file " << data_path << std::endl;
+        map_len = 0;
+        return false;
+    }
+    map = static_cast<const uint8_t *>(ptr);
+    madvise(ptr, map_len, MADV_SEQUENTIAL);
+
+    size_t sample_bytes = (format == IqFileFormat::CF32) ? 2 * sizeof(float) : 2;
+    printf("Replaying %s: %s, %zu samples at %d Hz (%.1f s), %s\n",
+           data_path.c_str(), (format == IqFileFormat::CF32) ? "cf32" : "cu8",
+           map_len / sample_bytes, rate, (double)(map_len / sample_bytes) / rate,
+           realtime ? "real time" : "as fast as possible");
+    return true;
+}
+
+bool IqFileSource::run(IqBlockCallback cb, void *ctx, uint32_t block_size) {
+    size_t sample_bytes = iq_sample_bytes(sample_format());
+    size_t total_samples = map_len / sample_bytes;
+    size_t block_samples = block_size / sample_bytes;
+
+    auto start = std::chrono::steady_clock::now();
+    size_t pos = 0;
+    while (pos < total_samples && !stopping) {
+        size_t n = std::min(block_samples, total_samples - pos);
+
+        // Handed out of the mapping without an intermediate buffer; the
+        // block pool copies it like a USB transfer
+        unsigned char *block = const_cast<unsigned char *>(map + pos * sample_bytes);
+        cb(block, static_cast<uint32_t>(n * sample_bytes), ctx);
+        pos += n;
+        delivered.store(pos);
+
+        if (realtime) {
+            auto due = start + std::chrono::microseconds(static_cast<int64_t>(pos * 1e6 / rate));
+            std::this_thread::sleep_until(due);
+        }
+    }
+
+    done = true;
+    return true;
+}
+
+bool IqFileSource::set_center_freq(uint32_t freq) {
+    // A recording cannot be retuned; accept it so the scanner keeps cycling
+    freq_hz = freq;
+    return true;
+}
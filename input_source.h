@@ -0,0 +1,114 @@
+#ifndef _INPUT_SOURCE_H
+#define _INPUT_SOURCE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <rtl-sdr.h>
+#include "config.h"
+#include "iq_convert.h"
+
+// Same shape as the librtlsdr async callback: interleaved I/Q bytes in
+// the source's sample_format()
+typedef void (*IqBlockCallback)(unsigned char *buf, uint32_t len, void *ctx);
+
+// Where IQ samples come from. run() blocks on the calling thread and
+// delivers fixed-size blocks until stop() is called or the input ends.
+class InputSource {
+    public:
+        virtual ~InputSource() {}
+        virtual const char *name() const = 0;
+
+        // Open and configure the source; false with a message on error
+        virtual bool open() = 0;
+        // Returns false if the source failed, true when stopped or at end
+        virtual bool run(IqBlockCallback cb, void *ctx, uint32_t block_size) = 0;
+        virtual void stop() = 0;
+
+        virtual bool set_center_freq(uint32_t freq_hz) = 0;
+        virtual uint32_t center_freq() const = 0;
+        virtual int sample_rate() const = 0;
+
+        // Format of the blocks handed to the callback
+        virtual IqSampleFormat sample_format() const { return IqSampleFormat::CU8; }
+        // True for live hardware, false for replayed recordings
+        virtual bool is_live() const { return true; }
+        // True when the source waits for the consumer instead of dropping
+        // blocks, i.e. a recording replayed as fast as possible. Real time
+        // replay drops like the dongle does.
+        virtual bool lossless() const { return false; }
+        // Recordings: true once every sample has been delivered
+        virtual bool finished() const { return false; }
+};
+
+class RtlSdrSource : public InputSource {
+    public:
+        explicit RtlSdrSource(const Config &config);
+        ~RtlSdrSource();
+        const char *name() const { return "rtl-sdr"; }
+        bool open();
+        bool run(IqBlockCallback cb, void *ctx, uint32_t block_size);
+        void stop();
+        bool set_center_freq(uint32_t freq_hz);
+        uint32_t center_freq() const;
+        int sample_rate() const { return config.sample_rate; }
+
+    private:
+        const Config &config;
+        rtlsdr_dev_t *dev;
+};
+
+enum class IqFileFormat {
+    AUTO,
+    CU8,    // Unsigned 8-bit interleaved, rtl_sdr output
+    CF32,   // 32-bit float interleaved, little endian
+    SIGMF   // SigMF recording, cu8 or cf32_le
+};
+
+// Replays a recording through a read-only memory map. Blocks of either
+// cu8 or cf32 are handed out straight from the mapping, in the
+// recording's own format, so cf32 keeps its dynamic range. Paced at the
+// sample rate, or as fast as the consumer accepts blocks.
+class IqFileSource : public InputSource {
+    public:
+        IqFileSource(const Config &config);
+        ~IqFileSource();
+        const char *name() const { return "file"; }
+        bool open();
+        bool run(IqBlockCallback cb, void *ctx, uint32_t block_size);
+        void stop() { stopping = true; }
+        bool set_center_freq(uint32_t freq_hz);
+        uint32_t center_freq() const { return freq_hz; }
+        int sample_rate() const { return rate; }
+        IqSampleFormat sample_format() const {
+            return (format == IqFileFormat::CF32) ? IqSampleFormat::CF32 : IqSampleFormat::CU8;
+        }
+        bool is_live() const { return false; }
+        bool lossless() const { return !realtime; }
+        bool finished() const { return done.load(); }
+
+        uint64_t samples_delivered() const { return delivered.load(); }
+
+    private:
+        bool read_sigmf_meta(const std::string &meta_path);
+
+        std::string path;
+        IqFileFormat format;
+        bool realtime;
+        int rate;
+        uint32_t freq_hz;
+
+        int fd;
+        const uint8_t *map;
+        size_t map_len;
+
+        std::atomic<bool> stopping;
+        std::atomic<bool> done;
+        std::atomic<uint64_t> delivered;
+};
+
+IqFileFormat iq_file_format_parse(const std::string &name);
+
+#endif // _INPUT_SOURCE_H
@@ -0,0 +1,71 @@
+#include <cstring>
+#include "iq_block_ring.h"
+#include "dsp_context.h"
+
+IqBlockRing::IqBlockRing(size_t block_count, size_t block_size, size_t consumers) :
+    slots(block_count),
+    storage(nullptr),
+    slot_size(block_size),
+    head(0),
+    drops(0),
+    cursors(consumers)
+{
+    storage = static_cast<uint8_t *>(dsp_aligned_alloc(block_count * block_size));
+    for (size_t i = 0; i < block_count; i++) {
+        slots[i].data = storage + i * block_size;
+        slots[i].len = 0;
+        slots[i].seq = 0;
+    }
+    for (size_t i = 0; i < cursors.size(); i++) {
+        cursors[i].tail.store(0, std::memory_order_relaxed);
+    }
+}
+
+IqBlockRing::~IqBlockRing() {
+    dsp_aligned_free(storage);
+}
+
+uint64_t IqBlockRing::slowest_tail() const {
+    uint64_t tail = head.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < cursors.size(); i++) {
+        uint64_t t = cursors[i].tail.load(std::memory_order_acquire);
+        if (t < tail) tail = t;
+    }
+    return tail;
+}
+
+bool IqBlockRing::push(const uint8_t *data, size_t len) {
+    uint64_t h = head.load(std::memory_order_relaxed);
+    if (len > slot_size || h - slowest_tail() >= slots.size()) {
+        drops.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    IqBlock &slot = slots[h % slots.size()];
+    memcpy(slot.data, data, len);
+    slot.len = len;
+    slot.seq = h;
+    slot.arrival = std::chrono::steady_clock::now();
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+const IqBlock *IqBlockRing::peek(size_t consumer) {
+    uint64_t t = cursors[consumer].tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    return &slots[t % slots.size()];
+}
+
+void IqBlockRing::release(size_t consumer) {
+    cursors[consumer].tail.fetch_add(1, std::memory_order_release);
+}
+
+bool IqBlockRing::full() const {
+    return head.load(std::memory_order_relaxed) - slowest_tail() >= slots.size();
+}
+
+size_t IqBlockRing::pending(size_t consumer) const {
+    return head.load(std::memory_order_acquire) - cursors[consumer].tail.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,66 @@
+#ifndef _IQ_BLOCK_RING_H
+#define _IQ_BLOCK_RING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct IqBlock {
+    uint8_t *data;
+    size_t len;
+    uint64_t seq;       // Producer sequence number
+    std::chrono::steady_clock::time_point arrival;  // When push() received it
+};
+
+// Preallocated pool of raw IQ blocks handed from the USB callback to the
+// DSP thread(s) without locks. One producer copies blocks in; every
+// consumer reads every block through its own cursor, and a slot is only
+// reused once all consumers have released it. When the slowest consumer
+// falls a whole pool behind, new blocks are dropped and counted instead
+// of stalling the producer.
+class IqBlockRing {
+    public:
+        IqBlockRing(size_t block_count, size_t block_size, size_t consumers = 1);
+        ~IqBlockRing();
+
+        // Producer: copy 'len' bytes into the next free slot. Returns false
+        // if the pool is full or the block too large; the block is dropped.
+        bool push(const uint8_t *data, size_t len);
+
+        // Consumer: oldest block not yet released by 'consumer', or nullptr
+        const IqBlock *peek(size_t consumer);
+        void release(size_t consumer);
+
+        size_t pending(size_t consumer) const;
+        // True if a push() right now would drop the block
+        bool full() const;
+        size_t block_size() const { return slot_size; }
+        size_t block_count() const { return slots.size(); }
+        uint64_t dropped() const { return drops.load(std::memory_order_relaxed); }
+        uint64_t pushed() const { return head.load(std::memory_order_relaxed); }
+
+    private:
+        IqBlockRing(const IqBlockRing &);
+        IqBlockRing &operator=(const IqBlockRing &);
+
+        static const size_t CACHE_LINE = 64;
+
+        // Each consumer cursor on its own cache line
+        struct Cursor {
+            std::atomic<uint64_t> tail;
+            char pad[CACHE_LINE - sizeof(std::atomic<uint64_t>)];
+        };
+
+        uint64_t slowest_tail() const;
+
+        std::vector<IqBlock> slots;
+        uint8_t *storage;
+        size_t slot_size;
+        std::atomic<uint64_t> head;
+        std::atomic<uint64_t> drops;
+        std::vector<Cursor> cursors;
+};
+
+#endif // _IQ_BLOCK_RING_H
@@ -0,0 +1,194 @@
+#include <cstdio>
+#include <cstring>
+#include "iq_convert.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IQ_HAVE_X86 1
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define IQ_HAVE_NEON 1
+#endif
+
+#define IQ_OFFSET 127.5f
+#define IQ_SCALE (1.0f / 127.5f)
+
+static float iq_lut[256];
+static IqConvertFn iq_convert_fn = nullptr;
+
+static void convert_scalar(const uint8_t *in, std::complex<float> *out, size_t samples) {
+    float *dst = reinterpret_cast<float *>(out);
+    for (size_t i = 0; i < samples * 2; i++) {
+        dst[i] = (in[i] - IQ_OFFSET) * IQ_SCALE;
+    }
+}
+
+static void convert_lut(const uint8_t *in, std::complex<float> *out, size_t samples) {
+    float *dst = reinterpret_cast<float *>(out);
+    for (size_t i = 0; i < samples * 2; i++) {
+        dst[i] = iq_lut[in[i]];
+    }
+}
+
+#ifdef IQ_HAVE_X86
+__attribute__((target("sse2")))
+static void convert_sse2(const uint8_t *in, std::complex<float> *out, size_t samples) {
+    float *dst = reinterpret_cast<float *>(out);
+    size_t n = samples * 2;
+    size_t i = 0;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 offset = _mm_set1_ps(IQ_OFFSET);
+    const __m128 scale = _mm_set1_ps(IQ_SCALE);
+
+    // 16 bytes -> 16 floats per iteration
+    for (; i + 16 <= n; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        __m128i lo16 = _mm_unpacklo_epi8(bytes, zero);
+        __m128i hi16 = _mm_unpackhi_epi8(bytes, zero);
+        __m128i w0 = _mm_unpacklo_epi16(lo16, zero);
+        __m128i w1 = _mm_unpackhi_epi16(lo16, zero);
+        __m128i w2 = _mm_unpacklo_epi16(hi16, zero);
+        __m128i w3 = _mm_unpackhi_epi16(hi16, zero);
+        _mm_storeu_ps(dst + i,      _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(w0), offset), scale));
+        _mm_storeu_ps(dst + i + 4,  _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(w1), offset), scale));
+        _mm_storeu_ps(dst + i + 8,  _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(w2), offset), scale));
+        _mm_storeu_ps(dst + i + 12, _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(w3), offset), scale));
+    }
+    for (; i < n; i++) {
+        dst[i] = (in[i] - IQ_OFFSET) * IQ_SCALE;
+    }
+}
+
+__attribute__((target("avx2")))
+static void convert_avx2(const uint8_t *in, std::complex<float> *out, size_t samples) {
+    float *dst = reinterpret_cast<float *>(out);
+    size_t n = samples * 2;
+    size_t i = 0;
+    const __m256 offset = _mm256_set1_ps(IQ_OFFSET);
+    const __m256 scale = _mm256_set1_ps(IQ_SCALE);
+
+    // 32 bytes -> 32 floats per iteration
+    for (; i + 32 <= n; i += 32) {
+        for (size_t k = 0; k < 32; k += 8) {
+            __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + i + k));
+            __m256 f = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+            _mm256_storeu_ps(dst + i + k, _mm256_mul_ps(_mm256_sub_ps(f, offset), scale));
+        }
+    }
+    for (; i < n; i++) {
+        dst[i] = (in[i] - IQ_OFFSET) * IQ_SCALE;
+    }
+}
+#endif
+
+#ifdef IQ_HAVE_NEON
+static void convert_neon(const uint8_t *in, std::complex<float> *out, size_t samples) {
+    float *dst = reinterpret_cast<float *>(out);
+    size_t n = samples * 2;
+    size_t i = 0;
+    const float32x4_t offset = vdupq_n_f32(IQ_OFFSET);
+    const float32x4_t scale = vdupq_n_f32(IQ_SCALE);
+
+    // 16 bytes -> 16 floats per iteration
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t bytes = vld1q_u8(in + i);
+        uint16x8_t lo16 = vmovl_u8(vget_low_u8(bytes));
+        uint16x8_t hi16 = vmovl_u8(vget_high_u8(bytes));
+        float32x4_t f0 = vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo16)));
+        float32x4_t f1 = vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo16)));
+        float32x4_t f2 = vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi16)));
+        float32x4_t f3 = vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi16)));
+        vst1q_f32(dst + i,      vmulq_f32(vsubq_f32(f0, offset), scale));
+        vst1q_f32(dst + i + 4,  vmulq_f32(vsubq_f32(f1, offset), scale));
+        vst1q_f32(dst + i + 8,  vmulq_f32(vsubq_f32(f2, offset), scale));
+        vst1q_f32(dst + i + 12, vmulq_f32(vsubq_f32(f3, offset), scale));
+    }
+    for (; i < n; i++) {
+        dst[i] = (in[i] - IQ_OFFSET) * IQ_SCALE;
+    }
+}
+#endif
+
+static bool iq_convert_supported(IqConvertImpl impl) {
+    switch (impl) {
+        case IqConvertImpl::SCALAR:
+        case IqConvertImpl::LUT:
+            return true;
+#ifdef IQ_HAVE_X86
+        case IqConvertImpl::SSE2:
+            return __builtin_cpu_supports("sse2");
+        case IqConvertImpl::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+#ifdef IQ_HAVE_NEON
+        case IqConvertImpl::NEON:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+IqConvertImpl iq_convert_init(IqConvertImpl requested) {
+    for (int i = 0; i < 256; i++) {
+        iq_lut[i] = (i - IQ_OFFSET) * IQ_SCALE;
+    }
+
+    IqConvertImpl impl = requested;
+    if (impl == IqConvertImpl::AUTO || !iq_convert_supported(impl)) {
+        if (impl != IqConvertImpl::AUTO) {
+            printf("IQ conversion '%s' not supported on this CPU, using auto\n", iq_convert_name(impl));
+        }
+        if (iq_convert_supported(IqConvertImpl::AVX2)) impl = IqConvertImpl::AVX2;
+        else if (iq_convert_supported(IqConvertImpl::SSE2)) impl = IqConvertImpl::SSE2;
+        else if (iq_convert_supported(IqConvertImpl::NEON)) impl = IqConvertImpl::NEON;
+        else impl = IqConvertImpl::LUT;
+    }
+
+    switch (impl) {
+#ifdef IQ_HAVE_X86
+        case IqConvertImpl::SSE2: iq_convert_fn = convert_sse2; break;
+        case IqConvertImpl::AVX2: iq_convert_fn = convert_avx2; break;
+#endif
+#ifdef IQ_HAVE_NEON
+        case IqConvertImpl::NEON: iq_convert_fn = convert_neon; break;
+#endif
+        case IqConvertImpl::LUT: iq_convert_fn = convert_lut; break;
+        default: iq_convert_fn = convert_scalar; break;
+    }
+    return impl;
+}
+
+void iq_convert_u8(const uint8_t *in, std::complex<float> *out, size_t samples) {
+    iq_convert_fn(in, out, samples);
+}
+
+void iq_convert(IqSampleFormat format, const uint8_t *in, std::complex<float> *out, size_t samples) {
+    if (format == IqSampleFormat::CF32) {
+        memcpy(out, in, samples * sizeof(std::complex<float>));
+    } else {
+        iq_convert_fn(in, out, samples);
+    }
+}
+
+IqConvertImpl iq_convert_parse(const std::string &name) {
+    if (name == "scalar") return IqConvertImpl::SCALAR;
+    if (name == "lut") return IqConvertImpl::LUT;
+    if (name == "sse2") return IqConvertImpl::SSE2;
+    if (name == "avx2") return IqConvertImpl::AVX2;
+    if (name == "neon") return IqConvertImpl::NEON;
+    return IqConvertImpl::AUTO;
+}
+
+const char *iq_convert_name(IqConvertImpl impl) {
+    switch (impl) {
+        case IqConvertImpl::SCALAR: return "scalar";
+        case IqConvertImpl::LUT: return "lut";
+        case IqConvertImpl::SSE2: return "sse2";
+        case IqConvertImpl::AVX2: return "avx2";
+        case IqConvertImpl::NEON: return "neon";
+        default: return "auto";
+    }
+}
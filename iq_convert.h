@@ -0,0 +1,46 @@
+#ifndef _IQ_CONVERT_H
+#define _IQ_CONVERT_H
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Conversion of interleaved unsigned 8-bit I/Q (RTL-SDR native format) to
+// complex float in [-1, 1]. The implementation is picked once at startup.
+enum class IqConvertImpl {
+    AUTO,    // Best SIMD path the CPU supports, LUT otherwise
+    SCALAR,
+    LUT,     // 256-entry lookup table
+    SSE2,
+    AVX2,
+    NEON
+};
+
+typedef void (*IqConvertFn)(const uint8_t *in, std::complex<float> *out, size_t samples);
+
+// Select the kernel, returns the one actually in use. Requesting a SIMD
+// path the CPU or build does not support falls back to AUTO.
+IqConvertImpl iq_convert_init(IqConvertImpl requested);
+
+// Convert 'samples' I/Q pairs (2 * samples bytes)
+void iq_convert_u8(const uint8_t *in, std::complex<float> *out, size_t samples);
+
+// Sample format of raw IQ blocks
+enum class IqSampleFormat {
+    CU8,     // Unsigned 8-bit, the dongle's own format
+    CF32     // Little endian 32-bit float, from cf32 recordings
+};
+
+inline size_t iq_sample_bytes(IqSampleFormat format) {
+    return (format == IqSampleFormat::CF32) ? 2 * sizeof(float) : 2;
+}
+
+// Convert 'samples' I/Q pairs of either format. cf32 is taken as is, so
+// recordings keep their full dynamic range.
+void iq_convert(IqSampleFormat format, const uint8_t *in, std::complex<float> *out, size_t samples);
+
+IqConvertImpl iq_convert_parse(const std::string &name);
+const char *iq_convert_name(IqConvertImpl impl);
+
+#endif // _IQ_CONVERT_H
@@ -0,0 +1,77 @@
+#include <cstdio>
+#include "latency.h"
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+// Values below 4 us get a bucket each; above that, each octave is split
+// into SUB_BUCKETS by the two bits after the leading one
+int LatencyHistogram::bucket_index(uint64_t us) {
+    if (us < SUB_BUCKETS) {
+        return static_cast<int>(us);
+    }
+    int msb = 2;
+    while ((us >> (msb + 1)) != 0) {
+        msb++;
+    }
+    int sub = static_cast<int>((us >> (msb - 2)) & (SUB_BUCKETS - 1));
+    return (msb - 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::bucket_upper(int index) {
+    if (index < SUB_BUCKETS) {
+        return static_cast<uint64_t>(index);
+    }
+    int msb = index / SUB_BUCKETS + 1;
+    uint64_t sub = index % SUB_BUCKETS;
+    return ((SUB_BUCKETS + sub + 1) << (msb - 2)) - 1;
+}
+
+void LatencyHistogram::record(std::chrono::steady_clock::duration d) {
+    int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    record_us(us > 0 ? static_cast<uint64_t>(us) : 0);
+}
+
+void LatencyHistogram::record_us(uint64_t us) {
+    buckets[bucket_index(us)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    uint64_t m = max.load(std::memory_order_relaxed);
+    while (us > m && !max.compare_exchange_weak(m, us, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t LatencyHistogram::percentile_us(double p) const {
+    uint64_t n = count();
+    if (n == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(p * n);
+    if (rank >= n) {
+        rank = n - 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen > rank) {
+            uint64_t upper = bucket_upper(i);
+            return upper < max_us() ? upper : max_us();
+        }
+    }
+    return max_us();
+}
+
+std::string LatencyHistogram::summary_ms() const {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.1f/%.1f/%.1f",
+             percentile_us(0.50) / 1000.0, percentile_us(0.99) / 1000.0, max_us() / 1000.0);
+    return buf;
+}
+
+void LatencyHistogram::reset() {
+    for (int i = 0; i < BUCKETS; i++) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+    total.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+}
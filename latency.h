@@ -0,0 +1,42 @@
+#ifndef _LATENCY_H
+#define _LATENCY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Latency histogram with logarithmic buckets, four per octave, so a
+// percentile is within 25% of the true value. One thread records while
+// others read, without locks.
+class LatencyHistogram {
+    public:
+        LatencyHistogram();
+
+        void record(std::chrono::steady_clock::duration d);
+        void record_us(uint64_t us);
+
+        uint64_t count() const { return total.load(std::memory_order_relaxed); }
+        uint64_t max_us() const { return max.load(std::memory_order_relaxed); }
+
+        // Upper edge of the bucket holding quantile p (0..1), in microseconds
+        uint64_t percentile_us(double p) const;
+
+        // "p50/p99/max" in milliseconds
+        std::string summary_ms() const;
+
+        void reset();
+
+    private:
+        static const int SUB_BUCKETS = 4;
+        static const int BUCKETS = 64 * SUB_BUCKETS;
+
+        static int bucket_index(uint64_t us);
+        static uint64_t bucket_upper(int index);
+
+        std::atomic<uint64_t> buckets[BUCKETS];
+        std::atomic<uint64_t> total;
+        std::atomic<uint64_t> max;
+};
+
+#endif // _LATENCY_H
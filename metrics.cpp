@@ -0,0 +1,200 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "metrics.h"
+
+#define METRICS_POLL_MS 250         // How often the server checks for stop()
+#define METRICS_CLIENT_TIMEOUT_S 2  // Give up on a client that stops talking
+#define METRICS_MAX_REQUEST 4096
+
+#ifdef MSG_NOSIGNAL
+#define METRICS_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define METRICS_SEND_FLAGS 0
+#endif
+
+void MetricsText::family(const char *name, const char *type, const char *help) {
+    text += "# HELP ";
+    text += name;
+    text += " ";
+    text += help;
+    text += "\n# TYPE ";
+    text += name;
+    text += " ";
+    text += type;
+    text += "\n";
+}
+
+void MetricsText::begin_sample(const char *name, const std::string &labels) {
+    text += name;
+    if (!labels.empty()) {
+        text += "{" + labels + "}";
+    }
+    text += " ";
+}
+
+void MetricsText::sample(const char *name, const std::string &labels, double value) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.9g\n", value);
+    begin_sample(name, labels);
+    text += buf;
+}
+
+void MetricsText::sample(const char *name, const std::string &labels, uint64_t value) {
+    begin_sample(name, labels);
+    text += std::to_string(value) + "\n";
+}
+
+std::string MetricsText::label(const char *key, const std::string &value) {
+    std::string out = key;
+    out += "=\"";
+    for (size_t i = 0; i < value.size(); i++) {
+        char c = value[i];
+        if (c == '\\' || c == '"') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else {
+            out += c;
+        }
+    }
+    out += "\"";
+    return out;
+}
+
+MetricsServer::MetricsServer(Collector collect) :
+    collect(collect),
+    listen_fd(-1),
+    stopping(false)
+{
+}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+bool MetricsServer::start(const std::string &bind_address, int port) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, bind_address.c_str(), &addr.sin_addr) != 1) {
+        std::cerr << "Invalid metrics bind address: " << bind_address << std::endl;
+        return false;
+    }
+
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        std::cerr << "Failed to create metrics socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(listen_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        listen(listen_fd, 8) < 0) {
+        std::cerr << "Failed to listen for metrics on " << bind_address << ":" << port
+                  << ": " << strerror(errno) << std::endl;
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    stopping = false;
+    thread = std::thread(&MetricsServer::run, this);
+    printf("Serving metrics on http://%s:%d/metrics\n", bind_address.c_str(), port);
+    return true;
+}
+
+void MetricsServer::stop() {
+    stopping = true;
+    if (thread.joinable()) {
+        thread.join();
+    }
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        listen_fd = -1;
+    }
+}
+
+void MetricsServer::run() {
+    while (!stopping) {
+        struct pollfd pfd;
+        pfd.fd = listen_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, METRICS_POLL_MS) <= 0) {
+            continue;
+        }
+        int client = accept(listen_fd, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+        handle(client);
+        close(client);
+    }
+}
+
+// Read the request head, answer it and let the caller close the connection
+void MetricsServer::handle(int client) {
+    struct timeval timeout;
+    timeout.tv_sec = METRICS_CLIENT_TIMEOUT_S;
+    timeout.tv_usec = 0;
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::string request;
+    char buf[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < METRICS_MAX_REQUEST) {
+        ssize_t n = recv(client, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            break;
+        }
+        request.append(buf, n);
+    }
+
+    // Path of the request-target, without the query string
+    bool get = request.compare(0, 4, "GET ") == 0;
+    std::string path;
+    if (get) {
+        size_t end = request.find_first_of(" ?\r\n", 4);
+        path = request.substr(4, end == std::string::npos ? std::string::npos : end - 4);
+    }
+
+    std::string status;
+    std::string body;
+    std::string content_type = "text/plain; charset=utf-8";
+    if (get && path == "/metrics") {
+        MetricsText text;
+        collect(text);
+        status = "200 OK";
+        body = text.str();
+        content_type = "text/plain; version=0.0.4; charset=utf-8";
+    } else if (get) {
+        status = "404 Not Found";
+        body = "Metrics are at /metrics\n";
+    } else {
+        status = "405 Method Not Allowed";
+        body = "Only GET is supported\n";
+    }
+
+    std::string response = "HTTP/1.0 " + status + "\r\n"
+                           "Content-Type: " + content_type + "\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                           "Connection: close\r\n\r\n" + body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t n = send(client, response.data() + sent, response.size() - sent, METRICS_SEND_FLAGS);
+        if (n <= 0) {
+            break;
+        }
+        sent += n;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef _METRICS_H
+#define _METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+// Prometheus text exposition format, built fresh for every scrape
+class MetricsText {
+    public:
+        // HELP and TYPE lines of a metric family; its samples follow
+        void family(const char *name, const char *type, const char *help);
+
+        // One sample. 'labels' is a list such as channel="main",stage="dsp"
+        // without braces, or empty.
+        void sample(const char *name, const std::string &labels, double value);
+        void sample(const char *name, const std::string &labels, uint64_t value);
+
+        // key="value" with the value escaped
+        static std::string label(const char *key, const std::string &value);
+
+        const std::string &str() const { return text; }
+
+    private:
+        void begin_sample(const char *name, const std::string &labels);
+
+        std::string text;
+};
+
+// Minimal HTTP server for Prometheus scrapes. Answers GET /metrics from
+// its own thread, one connection at a time, by running the collector.
+class MetricsServer {
+    public:
+        typedef std::function<void(MetricsText &)> Collector;
+
+        explicit MetricsServer(Collector collect);
+        ~MetricsServer();
+
+        bool start(const std::string &bind_address, int port);
+        void stop();
+
+    private:
+        MetricsServer(const MetricsServer &);
+        MetricsServer &operator=(const MetricsServer &);
+
+        void run();
+        void handle(int client);
+
+        Collector collect;
+        int listen_fd;
+        std::atomic<bool> stopping;
+        std::thread thread;
+};
+
+#endif // _METRICS_H
@@ -0,0 +1,147 @@
+#include <algorithm>
+#include "mp3_queue.h"
+
+#define MP3_QUEUE_WAIT_MS 100  // BLOCK policy: recheck 'running' this often
+
+// Power of two holding every frame index at once
+static size_t ring_size(size_t frames) {
+    size_t ring = 1;
+    while (ring < frames) {
+        ring <<= 1;
+    }
+    return ring;
+}
+
+Mp3FrameQueue::Mp3FrameQueue(size_t depth, size_t frame_capacity, Mp3Overflow policy) :
+    spare(nullptr),
+    queue_depth(depth),
+    overflow(policy),
+    ready_ring(ring_size(depth + 2)),
+    ready_mask(ring_size(depth + 2) - 1),
+    head(0),
+    tail(0),
+    free_frames(depth + 2),
+    queued_bytes(0),
+    drops_oldest(0),
+    drops_newest(0)
+{
+    size_t count = depth + 2;
+    slab.resize((count + 1) * frame_capacity);
+    frames.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        frames[i].data = slab.data() + i * frame_capacity;
+        frames[i].capacity = frame_capacity;
+        frames[i].size = 0;
+        frames[i].duration = 0.0;
+        uint32_t index = static_cast<uint32_t>(i);
+        free_frames.write(&index, 1);
+    }
+    scratch.data = slab.data() + count * frame_capacity;
+    scratch.capacity = frame_capacity;
+    scratch.size = 0;
+    scratch.duration = 0.0;
+}
+
+Mp3FrameQueue::Frame *Mp3FrameQueue::take_free() {
+    uint32_t index;
+    if (free_frames.read(&index, 1) == 1) {
+        return &frames[index];
+    }
+    return nullptr;
+}
+
+// Pop the oldest queued frame; the sender and the encoder may race for it
+Mp3FrameQueue::Frame *Mp3FrameQueue::take_oldest() {
+    uint64_t t = tail.load(std::memory_order_acquire);
+    while (t != head.load(std::memory_order_acquire)) {
+        uint32_t index = ready_ring[t & ready_mask].load(std::memory_order_relaxed);
+        if (tail.compare_exchange_weak(t, t + 1, std::memory_order_acq_rel)) {
+            queued_bytes.fetch_sub(frames[index].size, std::memory_order_relaxed);
+            return &frames[index];
+        }
+    }
+    return nullptr;
+}
+
+Mp3FrameQueue::Frame *Mp3FrameQueue::acquire(const std::atomic<bool> &running) {
+    Frame *frame = spare;
+    spare = nullptr;
+    if (!frame && size() < queue_depth) {
+        frame = take_free();
+    }
+    while (!frame) {
+        if (overflow == Mp3Overflow::DROP_OLDEST) {
+            frame = take_oldest();
+            if (frame) {
+                drops_oldest.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                // The sender emptied the queue meanwhile
+                frame = take_free();
+            }
+        } else if (overflow == Mp3Overflow::BLOCK && running) {
+            uint64_t epoch = freed.epoch();
+            if (size() < queue_depth) {
+                frame = take_free();
+            }
+            if (!frame) {
+                freed.wait(epoch, std::chrono::milliseconds(MP3_QUEUE_WAIT_MS));
+            }
+            continue;
+        }
+        if (!frame) {
+            frame = &scratch;
+        }
+    }
+    frame->size = 0;
+    return frame;
+}
+
+bool Mp3FrameQueue::commit(Frame *frame) {
+    if (frame == &scratch) {
+        if (frame->size > 0) {
+            drops_newest.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+    if (frame->size == 0) {
+        spare = frame;
+        return true;
+    }
+
+    // Never more than frames.size() indices in flight, so the ring
+    // cannot overrun its tail
+    uint64_t h = head.load(std::memory_order_relaxed);
+    ready_ring[h & ready_mask].store(static_cast<uint32_t>(frame - frames.data()), std::memory_order_relaxed);
+    queued_bytes.fetch_add(frame->size, std::memory_order_relaxed);
+    head.store(h + 1, std::memory_order_release);
+    ready.notify();
+    return true;
+}
+
+Mp3FrameQueue::Frame *Mp3FrameQueue::claim() {
+    return take_oldest();
+}
+
+void Mp3FrameQueue::release(Frame *frame) {
+    uint32_t index = static_cast<uint32_t>(frame - frames.data());
+    free_frames.write(&index, 1);
+    freed.notify();
+}
+
+void Mp3FrameQueue::wake() {
+    ready.notify();
+    freed.notify();
+}
+
+Mp3Overflow Mp3FrameQueue::parse_policy(const std::string &name) {
+    if (name == "drop_oldest") return Mp3Overflow::DROP_OLDEST;
+    if (name == "block") return Mp3Overflow::BLOCK;
+    return Mp3Overflow::DROP_NEWEST;
+}
+
+const char *Mp3FrameQueue::policy_name(Mp3Overflow policy) {
+    if (policy == Mp3Overflow::DROP_OLDEST) return "drop_oldest";
+    if (policy == Mp3Overflow::BLOCK) return "block";
+    return "drop_newest";
+}
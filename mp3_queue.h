@@ -0,0 +1,97 @@
+#ifndef _MP3_QUEUE_H
+#define _MP3_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ringbuffer.h"
+#include "notifier.h"
+
+enum class Mp3Overflow {
+    DROP_OLDEST,   // Reuse the oldest queued frame, keeping the stream current
+    DROP_NEWEST,   // Discard the chunk just encoded
+    BLOCK          // Stall the encoder until the sender frees a frame
+};
+
+// Bounded queue of encoded MP3 chunks between one encoder and one sender
+// thread. The frames are preallocated; the encoder writes into a frame
+// and passes its index to the sender, which hands it back once sent, so
+// nothing is copied or allocated per chunk and no lock is taken.
+class Mp3FrameQueue {
+    public:
+        struct Frame {
+            unsigned char *data;
+            size_t capacity;
+            size_t size;
+            double duration;   // Seconds of audio encoded into the frame, for pacing
+            std::chrono::steady_clock::time_point arrival;  // IQ arrival of the first sample
+            std::chrono::steady_clock::time_point queued;
+        };
+
+        // 'depth' frames can wait for the sender; two more are kept for
+        // the one being encoded and the one being sent
+        Mp3FrameQueue(size_t depth, size_t frame_capacity, Mp3Overflow policy);
+
+        // Encoder: frame to encode the next chunk into. When the queue is
+        // full the policy decides; a chunk that will be dropped gets a
+        // scratch frame so LAME still sees every sample.
+        Frame *acquire(const std::atomic<bool> &running);
+        // Encoder: queue the frame (an empty one is kept for next time).
+        // Returns false if the chunk was dropped.
+        bool commit(Frame *frame);
+
+        // Sender: oldest queued frame, or nullptr. Give it back with
+        // release() once sent; until then it may be retried.
+        Frame *claim();
+        void release(Frame *frame);
+
+        // Sender: wait for commit(), see Notifier
+        uint64_t ready_epoch() const { return ready.epoch(); }
+        void wait_ready(uint64_t since, std::chrono::milliseconds timeout) { ready.wait(since, timeout); }
+        // Wake both sides, e.g. at shutdown
+        void wake();
+
+        size_t size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+        size_t depth() const { return queue_depth; }
+        size_t bytes() const { return queued_bytes.load(std::memory_order_relaxed); }
+        uint64_t dropped_oldest() const { return drops_oldest.load(std::memory_order_relaxed); }
+        uint64_t dropped_newest() const { return drops_newest.load(std::memory_order_relaxed); }
+        Mp3Overflow policy() const { return overflow; }
+
+        static Mp3Overflow parse_policy(const std::string &name);
+        static const char *policy_name(Mp3Overflow policy);
+
+    private:
+        Mp3FrameQueue(const Mp3FrameQueue &);
+        Mp3FrameQueue &operator=(const Mp3FrameQueue &);
+
+        Frame *take_free();
+        Frame *take_oldest();
+
+        std::vector<unsigned char> slab;
+        std::vector<Frame> frames;
+        Frame scratch;
+        Frame *spare;                 // Encoder: acquired, but nothing was committed
+        size_t queue_depth;
+        Mp3Overflow overflow;
+
+        // Queued frame indices. The encoder also takes from the tail to
+        // drop the oldest frame, so the tail is claimed with a CAS.
+        std::vector<std::atomic<uint32_t>> ready_ring;
+        size_t ready_mask;
+        std::atomic<uint64_t> head;
+        std::atomic<uint64_t> tail;
+
+        SpscRingBuffer<uint32_t> free_frames;  // Sender -> encoder
+        Notifier ready;
+        Notifier freed;
+
+        std::atomic<size_t> queued_bytes;
+        std::atomic<uint64_t> drops_oldest;
+        std::atomic<uint64_t> drops_newest;
+};
+
+#endif // _MP3_QUEUE_H
@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <lame/lame.h>
+#include "mp3_silence.h"
+
+#define SILENCE_ENCODE_FRAMES 64  // Frames of silence encoded to pick the cycle from
+#define SILENCE_SKIP_FRAMES 8     // Leading frames affected by the encoder start-up
+
+size_t mp3_frame_length(const unsigned char *h, size_t *samples) {
+    static const int bitrate_v1[16] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0};
+    static const int bitrate_v2[16] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0};
+    static const int rate_v1[3] = {44100, 48000, 32000};
+
+    if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0) {
+        return 0;
+    }
+    int version = (h[1] >> 3) & 3;     // 3 = MPEG-1, 2 = MPEG-2, 0 = MPEG-2.5
+    int layer = (h[1] >> 1) & 3;       // 1 = layer III
+    int bitrate_index = h[2] >> 4;
+    int rate_index = (h[2] >> 2) & 3;
+    int padding = (h[2] >> 1) & 1;
+    if (version == 1 || layer != 1 || bitrate_index == 0 || bitrate_index == 15 || rate_index == 3) {
+        return 0;
+    }
+
+    int rate = rate_v1[rate_index] >> (version == 3 ? 0 : (version == 2 ? 1 : 2));
+    int bitrate = (version == 3 ? bitrate_v1 : bitrate_v2)[bitrate_index] * 1000;
+    *samples = (version == 3) ? 1152 : 576;
+    return (version == 3 ? 144 : 72) * bitrate / rate + padding;
+}
+
+Mp3Silence::Mp3Silence() :
+    next_frame(0),
+    samples_per_frame(0),
+    pending_samples(0)
+{
+}
+
+bool Mp3Silence::build(int sample_rate, int bitrate_kbps, int channels) {
+    frames.clear();
+
+    lame_t lame = lame_init();
+    lame_set_in_samplerate(lame, sample_rate);
+    lame_set_out_samplerate(lame, sample_rate);
+    lame_set_num_channels(lame, channels);
+    lame_set_mode(lame, channels == 2 ? JOINT_STEREO : MONO);
+    lame_set_brate(lame, bitrate_kbps);
+    lame_set_VBR(lame, vbr_off);
+    lame_set_disable_reservoir(lame, 1);
+    if (lame_init_params(lame) < 0) {
+        lame_close(lame);
+        return false;
+    }
+
+    size_t frame_size = lame_get_framesize(lame);
+    std::vector<short> zeros(frame_size * SILENCE_ENCODE_FRAMES, 0);
+    std::vector<unsigned char> mp3(zeros.size() + 7200);
+    int bytes = lame_encode_buffer(lame, zeros.data(), channels == 2 ? zeros.data() : nullptr,
+                                   static_cast<int>(zeros.size()),
+                                   mp3.data(), static_cast<int>(mp3.size()));
+    lame_close(lame);
+    if (bytes <= 0) {
+        return false;
+    }
+
+    // Split into frames and keep the ones past the start-up
+    size_t pos = 0;
+    size_t index = 0;
+    while (pos + 4 <= static_cast<size_t>(bytes)) {
+        size_t samples = 0;
+        size_t len = mp3_frame_length(&mp3[pos], &samples);
+        if (len == 0 || pos + len > static_cast<size_t>(bytes)) {
+            break;
+        }
+        if (index >= SILENCE_SKIP_FRAMES) {
+            frames.push_back(std::vector<unsigned char>(mp3.begin() + pos, mp3.begin() + pos + len));
+            samples_per_frame = samples;
+        }
+        pos += len;
+        index++;
+    }
+    next_frame = 0;
+    pending_samples = 0;
+    return !frames.empty();
+}
+
+size_t Mp3Silence::encode(size_t samples, unsigned char *out, size_t out_size) {
+    if (frames.empty()) {
+        return 0;
+    }
+    pending_samples += samples;
+
+    size_t written = 0;
+    while (pending_samples >= samples_per_frame) {
+        const std::vector<unsigned char> &frame = frames[next_frame];
+        if (written + frame.size() > out_size) {
+            break;
+        }
+        std::copy(frame.begin(), frame.end(), out + written);
+        written += frame.size();
+        pending_samples -= samples_per_frame;
+        next_frame = (next_frame + 1) % frames.size();
+    }
+    return written;
+}
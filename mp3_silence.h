@@ -0,0 +1,38 @@
+#ifndef _MP3_SILENCE_H
+#define _MP3_SILENCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Pre-encoded MP3 frames of digital silence, streamed while the squelch
+// is closed instead of running LAME on zeros. Encoded with the bit
+// reservoir disabled, so each frame decodes on its own and can be spliced
+// between frames of a reservoir-free stream.
+class Mp3Silence {
+    public:
+        Mp3Silence();
+
+        // Encode the frames for the stream's sample rate, bitrate and
+        // channel count (joint stereo for 2)
+        bool build(int sample_rate, int bitrate_kbps, int channels);
+
+        // Write frames covering 'samples' of silence to out; the part of a
+        // frame left over carries to the next call. Returns bytes written.
+        size_t encode(size_t samples, unsigned char *out, size_t out_size);
+
+        size_t frame_samples() const { return samples_per_frame; }
+
+    private:
+        // One cycle of frames; at 44.1 kHz the padding varies per frame
+        std::vector<std::vector<unsigned char>> frames;
+        size_t next_frame;
+        size_t samples_per_frame;
+        size_t pending_samples;
+};
+
+// Length in bytes of the MPEG audio layer III frame starting at h, or 0 if
+// h is not a valid frame header. Sets *samples to the samples per frame.
+size_t mp3_frame_length(const unsigned char *h, size_t *samples);
+
+#endif // _MP3_SILENCE_H
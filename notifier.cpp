@@ -0,0 +1,30 @@
+#include "notifier.h"
+
+Notifier::Notifier() :
+    seq(0),
+    waiters(0)
+{
+}
+
+void Notifier::notify() {
+    // Sequentially consistent with wait(): either the waiter sees the new
+    // sequence number, or this sees the waiter and signals it
+    seq.fetch_add(1, std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_seq_cst) > 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        cond.notify_all();
+    }
+}
+
+bool Notifier::wait(uint64_t since, std::chrono::milliseconds timeout) {
+    waiters.fetch_add(1, std::memory_order_seq_cst);
+    bool woken;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        woken = cond.wait_for(lock, timeout, [this, since] {
+            return seq.load(std::memory_order_seq_cst) != since;
+        });
+    }
+    waiters.fetch_sub(1, std::memory_order_seq_cst);
+    return woken;
+}
@@ -0,0 +1,39 @@
+#ifndef _NOTIFIER_H
+#define _NOTIFIER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+// Wakes consumer threads when a producer has published something, so
+// they can block instead of polling. A consumer reads epoch(), checks its
+// queue and, if it has to wait, passes that epoch to wait(); a notify()
+// in between makes wait() return at once, so no wakeup is lost. notify()
+// only takes the mutex while a consumer is actually waiting, which keeps
+// it cheap enough for the USB callback.
+class Notifier {
+    public:
+        Notifier();
+
+        uint64_t epoch() const { return seq.load(std::memory_order_seq_cst); }
+
+        // Wake every thread waiting on this notifier
+        void notify();
+
+        // Block until notify() has been called since 'since' was read, or
+        // the timeout passes. Returns false on timeout.
+        bool wait(uint64_t since, std::chrono::milliseconds timeout);
+
+    private:
+        Notifier(const Notifier &);
+        Notifier &operator=(const Notifier &);
+
+        std::atomic<uint64_t> seq;
+        std::atomic<int> waiters;
+        std::mutex mutex;
+        std::condition_variable cond;
+};
+
+#endif // _NOTIFIER_H
@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "rds.h"
+
+#define RDS_BITRATE 1187.5
+#define RDS_MIN_RATE 19000.0        // Filtered rate, keeps 16 samples per symbol
+#define RDS_BANDWIDTH_HZ 2400.0f    // Biphase spectrum each side of the carrier
+#define RDS_STOPBAND_DB 50.0f
+#define RDS_TIMING_BINS 16          // Candidate sampling points per symbol
+#define RDS_TIMING_DECAY 0.99f      // Per symbol, ~100 symbols of timing memory
+#define RDS_AXIS_ALPHA 0.05f        // Carrier phase averaging per symbol
+#define RDS_BLOCK_BITS 26
+#define RDS_MAX_BAD_BLOCKS 12       // Consecutive checkword failures before sync is lost
+#define RDS_POLY 0x5B9              // x^10 + x^8 + x^7 + x^5 + x^4 + x^3 + 1
+
+// Offset words added to the checkwords of blocks A, B, C, D and C'
+static const uint16_t RDS_OFFSET[4] = { 0x0FC, 0x198, 0x168, 0x1B4 };
+static const uint16_t RDS_OFFSET_C2 = 0x350;
+
+// Checkword of a 16-bit information word before the offset is added
+static uint16_t rds_checkword(uint16_t data) {
+    uint32_t reg = static_cast<uint32_t>(data) << 10;
+    for (int bit = 25; bit >= 10; bit--) {
+        if (reg & (1u << bit)) {
+            reg ^= RDS_POLY << (bit - 10);
+        }
+    }
+    return reg & 0x3FF;
+}
+
+// Block (0..3 = A..D, C' as C) whose offset matches the 26 bits, or -1
+static int rds_match_block(uint32_t bits) {
+    uint16_t offset = (bits & 0x3FF) ^ rds_checkword(static_cast<uint16_t>(bits >> 10));
+    for (int i = 0; i < 4; i++) {
+        if (offset == RDS_OFFSET[i]) {
+            return i;
+        }
+    }
+    return (offset == RDS_OFFSET_C2) ? 2 : -1;
+}
+
+// Printable ASCII subset of the RDS character table
+static char rds_char(uint8_t c) {
+    return (c >= 0x20 && c < 0x7F) ? static_cast<char>(c) : ' ';
+}
+
+static std::string rds_trim(const char *text, size_t len) {
+    size_t start = 0;
+    while (start < len && text[start] == ' ') start++;
+    while (len > start && text[len - 1] == ' ') len--;
+    return std::string(text + start, len - start);
+}
+
+RdsDecoder::RdsDecoder() :
+    filter(nullptr),
+    decim(1),
+    filter_fill(0),
+    is_synced(false),
+    pi_code(0),
+    group_count(0),
+    error_count(0)
+{
+    reset();
+}
+
+RdsDecoder::~RdsDecoder() {
+    if (filter) {
+        firdecim_crcf_destroy(filter);
+    }
+}
+
+void RdsDecoder::set_input_rate(double input_rate) {
+    if (filter) {
+        firdecim_crcf_destroy(filter);
+    }
+    decim = std::max(1, static_cast<int>(input_rate / RDS_MIN_RATE));
+    double rate = input_rate / decim;
+
+    float fc = static_cast<float>(RDS_BANDWIDTH_HZ / input_rate);
+    float transition = static_cast<float>((0.5 * rate - RDS_BANDWIDTH_HZ) / input_rate);
+    unsigned int len = estimate_req_filter_len(transition, RDS_STOPBAND_DB);
+    len = std::max(len, 2 * decim + 1) | 1;
+    std::vector<float> taps(len);
+    liquid_firdes_kaiser(len, fc, RDS_STOPBAND_DB, 0.0f, taps.data());
+    float sum = 0.0f;
+    for (unsigned int i = 0; i < len; i++) sum += taps[i];
+    for (unsigned int i = 0; i < len; i++) taps[i] /= sum;
+    filter = firdecim_crcf_create(decim, taps.data(), len);
+    filter_buf.resize(decim);
+
+    clock_step = RDS_BITRATE / rate;
+    history.resize(static_cast<size_t>(std::lround(rate / RDS_BITRATE)));
+    bin_energy.resize(RDS_TIMING_BINS);
+    reset();
+}
+
+void RdsDecoder::reset() {
+    if (filter) {
+        firdecim_crcf_reset(filter);
+    }
+    filter_fill = 0;
+    std::fill(history.begin(), history.end(), std::complex<float>(0.0f, 0.0f));
+    history_pos = 0;
+    clock = 0.0;
+    last_bin = -1;
+    best_bin = 0;
+    std::fill(bin_energy.begin(), bin_energy.end(), 0.0f);
+    axis = std::complex<float>(0.0f, 0.0f);
+    prev_symbol = 0;
+
+    shift_reg = 0;
+    bit_count = 0;
+    have_candidate = false;
+    candidate_bit = 0;
+    candidate_block = 0;
+    expected_block = 0;
+    bits_in_block = 0;
+    bad_blocks = 0;
+    std::fill(group_valid, group_valid + 4, false);
+
+    memset(ps_buf, ' ', sizeof(ps_buf));
+    ps_segments = 0;
+    memset(rt_buf, ' ', sizeof(rt_buf));
+    rt_segments = 0;
+    rt_ab = -1;
+    {
+        std::lock_guard<std::mutex> lock(text_mutex);
+        ps_text.clear();
+        rt_text.clear();
+    }
+    is_synced.store(false, std::memory_order_relaxed);
+    pi_code.store(0, std::memory_order_relaxed);
+}
+
+std::string RdsDecoder::station_name() const {
+    std::lock_guard<std::mutex> lock(text_mutex);
+    return ps_text;
+}
+
+std::string RdsDecoder::radiotext() const {
+    std::lock_guard<std::mutex> lock(text_mutex);
+    return rt_text;
+}
+
+void RdsDecoder::process(const std::complex<float> *in, size_t count) {
+    if (!filter) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        filter_buf[filter_fill++] = in[i];
+        if (filter_fill == decim) {
+            std::complex<float> y;
+            firdecim_crcf_execute(filter, filter_buf.data(), &y);
+            filter_fill = 0;
+            demodulate(y);
+        }
+    }
+}
+
+// Biphase matched filter over the last symbol, sampled at the timing bin
+// where it has been strongest. The carrier is locked to the pilot, so the
+// BPSK axis only needs averaging; its sign does not matter because the
+// bits are differentially coded.
+void RdsDecoder::demodulate(std::complex<float> sample) {
+    size_t n = history.size();
+    history[history_pos] = sample;
+    history_pos = (history_pos + 1) % n;
+
+    // First chip minus second chip, oldest sample first
+    std::complex<float> m(0.0f, 0.0f);
+    for (size_t k = 0; k < n; k++) {
+        const std::complex<float> &h = history[(history_pos + k) % n];
+        m += (k < n / 2) ? h : -h;
+    }
+
+    clock += clock_step;
+    if (clock >= 1.0) {
+        clock -= 1.0;
+        best_bin = static_cast<int>(std::max_element(bin_energy.begin(), bin_energy.end()) - bin_energy.begin());
+        for (size_t b = 0; b < bin_energy.size(); b++) {
+            bin_energy[b] *= RDS_TIMING_DECAY;
+        }
+    }
+    int bin = std::min(RDS_TIMING_BINS - 1, static_cast<int>(clock * RDS_TIMING_BINS));
+    bin_energy[bin] += std::norm(m);
+    bool sample_now = (bin == best_bin && last_bin != best_bin);
+    last_bin = bin;
+    if (!sample_now) {
+        return;
+    }
+
+    axis += RDS_AXIS_ALPHA * (m * m - axis);
+    float phase = 0.5f * std::arg(axis);
+    float d = m.real() * std::cos(phase) + m.imag() * std::sin(phase);
+    int symbol = d > 0.0f ? 1 : 0;
+    receive_bit(symbol ^ prev_symbol);
+    prev_symbol = symbol;
+}
+
+void RdsDecoder::receive_bit(int bit) {
+    shift_reg = ((shift_reg << 1) | static_cast<uint32_t>(bit)) & ((1u << RDS_BLOCK_BITS) - 1);
+    bit_count++;
+
+    if (!is_synced.load(std::memory_order_relaxed)) {
+        // Two blocks at the right distance and in the right order
+        int block = (bit_count >= RDS_BLOCK_BITS) ? rds_match_block(shift_reg) : -1;
+        if (block < 0) {
+            return;
+        }
+        uint64_t distance = bit_count - candidate_bit;
+        if (have_candidate && distance % RDS_BLOCK_BITS == 0 && distance <= 6 * RDS_BLOCK_BITS &&
+            (candidate_block + distance / RDS_BLOCK_BITS) % 4 == static_cast<uint64_t>(block)) {
+            is_synced.store(true, std::memory_order_relaxed);
+            std::fill(group_valid, group_valid + 4, false);
+            expected_block = (block + 1) % 4;
+            bits_in_block = 0;
+            bad_blocks = 0;
+            receive_block(block, static_cast<uint16_t>(shift_reg >> 10));
+            return;
+        }
+        have_candidate = true;
+        candidate_bit = bit_count;
+        candidate_block = block;
+        return;
+    }
+
+    if (++bits_in_block < RDS_BLOCK_BITS) {
+        return;
+    }
+    bits_in_block = 0;
+    int block = expected_block;
+    expected_block = (block + 1) % 4;
+    if (block == 0) {
+        std::fill(group_valid, group_valid + 4, false);
+    }
+
+    uint16_t data = static_cast<uint16_t>(shift_reg >> 10);
+    uint16_t offset = (shift_reg & 0x3FF) ^ rds_checkword(data);
+    if (offset == RDS_OFFSET[block] || (block == 2 && offset == RDS_OFFSET_C2)) {
+        bad_blocks = 0;
+        receive_block(block, data);
+        return;
+    }
+
+    error_count.fetch_add(1, std::memory_order_relaxed);
+    if (++bad_blocks >= RDS_MAX_BAD_BLOCKS) {
+        is_synced.store(false, std::memory_order_relaxed);
+        have_candidate = false;
+        return;
+    }
+    if (block == 3) {
+        decode_group();
+    }
+}
+
+void RdsDecoder::receive_block(int block, uint16_t data) {
+    group[block] = data;
+    group_valid[block] = true;
+    if (block == 0) {
+        pi_code.store(data, std::memory_order_relaxed);
+    } else if (block == 3) {
+        decode_group();
+    }
+}
+
+void RdsDecoder::decode_group() {
+    if (!group_valid[1]) {
+        return;
+    }
+    group_count.fetch_add(1, std::memory_order_relaxed);
+    uint16_t b = group[1];
+    int type = b >> 12;
+    bool version_b = (b & 0x800) != 0;
+
+    if (type == 0 && group_valid[3]) {
+        // Basic tuning: two PS characters per group
+        int segment = b & 0x3;
+        ps_buf[segment * 2] = rds_char(group[3] >> 8);
+        ps_buf[segment * 2 + 1] = rds_char(group[3] & 0xFF);
+        ps_segments |= 1u << segment;
+        if (ps_segments == 0xF) {
+            std::lock_guard<std::mutex> lock(text_mutex);
+            ps_text = rds_trim(ps_buf, sizeof(ps_buf));
+            ps_segments = 0;
+        }
+    } else if (type == 2) {
+        // Radiotext: 4 characters per 2A group, 2 per 2B group
+        int ab = (b >> 4) & 0x1;
+        if (ab != rt_ab) {
+            rt_ab = ab;
+            memset(rt_buf, ' ', sizeof(rt_buf));
+            rt_segments = 0;
+        }
+        int segment = b & 0xF;
+        int per_segment = version_b ? 2 : 4;
+        uint8_t chars[4];
+        if (version_b) {
+            if (!group_valid[3]) {
+                return;
+            }
+            chars[0] = group[3] >> 8;
+            chars[1] = group[3] & 0xFF;
+        } else {
+            if (!group_valid[2] || !group_valid[3]) {
+                return;
+            }
+            chars[0] = group[2] >> 8;
+            chars[1] = group[2] & 0xFF;
+            chars[2] = group[3] >> 8;
+            chars[3] = group[3] & 0xFF;
+        }
+        for (int i = 0; i < per_segment; i++) {
+            rt_buf[segment * per_segment + i] = (chars[i] == 0x0D) ? '\r' : rds_char(chars[i]);
+        }
+        rt_segments |= 1u << segment;
+
+        // Complete once every segment up to the end of text has arrived
+        int length = 16 * per_segment;
+        for (int i = 0; i < length; i++) {
+            if (rt_buf[i] == '\r') {
+                length = i;
+                break;
+            }
+        }
+        int segments = (length < 16 * per_segment) ? length / per_segment + 1 : 16;
+        uint32_t needed = (1u << segments) - 1;
+        if ((rt_segments & needed) == needed) {
+            std::lock_guard<std::mutex> lock(text_mutex);
+            rt_text = rds_trim(rt_buf, length);
+            rt_segments = 0;
+        }
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef _RDS_H
+#define _RDS_H
+
+#include <atomic>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <liquid/liquid.h>
+
+// RDS decoder for the 57 kHz subcarrier of a broadcast FM multiplex.
+// Takes the subcarrier already mixed down to 0 Hz at the channel rate,
+// recovers the 1187.5 bit/s biphase symbols, finds block sync from the
+// checkwords and collects the station name (PS) and radiotext (RT).
+// process() runs on the DSP thread, the getters may be called from any
+// thread.
+class RdsDecoder {
+    public:
+        RdsDecoder();
+        ~RdsDecoder();
+
+        // Rate of the samples given to process(), resets the decoder
+        void set_input_rate(double input_rate);
+
+        void process(const std::complex<float> *in, size_t count);
+
+        // Drop sync and the station's texts, e.g. after a retune
+        void reset();
+
+        bool synced() const { return is_synced.load(std::memory_order_relaxed); }
+        uint16_t pi() const { return pi_code.load(std::memory_order_relaxed); }
+        // Complete texts only, empty until every segment has been received
+        std::string station_name() const;
+        std::string radiotext() const;
+
+        uint64_t groups() const { return group_count.load(std::memory_order_relaxed); }
+        uint64_t block_errors() const { return error_count.load(std::memory_order_relaxed); }
+
+    private:
+        RdsDecoder(const RdsDecoder &);
+        RdsDecoder &operator=(const RdsDecoder &);
+
+        void demodulate(std::complex<float> sample);
+        void receive_bit(int bit);
+        void receive_block(int block, uint16_t data);
+        void decode_group();
+
+        // Baseband filter, decimates to a few samples per biphase chip
+        firdecim_crcf filter;
+        unsigned int decim;
+        std::vector<std::complex<float>> filter_buf;
+        unsigned int filter_fill;
+
+        // Symbol recovery
+        std::vector<std::complex<float>> history;  // One symbol of filtered samples
+        size_t history_pos;
+        double clock;                  // Position within the symbol, 0..1
+        double clock_step;             // Symbols per filtered sample
+        int last_bin;
+        int best_bin;                  // Timing bin with the strongest matched filter output
+        std::vector<float> bin_energy;
+        std::complex<float> axis;      // Averaged square of the symbols, BPSK axis at half its angle
+        int prev_symbol;
+
+        // Block sync
+        uint32_t shift_reg;            // Last 26 bits
+        uint64_t bit_count;
+        bool have_candidate;
+        uint64_t candidate_bit;        // Bit where a block was seen while searching
+        int candidate_block;
+        int expected_block;            // Next block while synced, 0..3 = A..D
+        int bits_in_block;
+        int bad_blocks;                // Consecutive blocks with a wrong checkword
+
+        // Current group
+        uint16_t group[4];
+        bool group_valid[4];
+
+        // Text being assembled, published under text_mutex once complete
+        char ps_buf[8];
+        unsigned int ps_segments;      // Bit per 2-character segment received
+        char rt_buf[64];
+        uint32_t rt_segments;
+        int rt_ab;                     // Text A/B flag, a change clears the text
+        mutable std::mutex text_mutex;
+        std::string ps_text;
+        std::string rt_text;
+
+        std::atomic<bool> is_synced;
+        std::atomic<uint16_t> pi_code;
+        std::atomic<uint64_t> group_count;
+        std::atomic<uint64_t> error_count;
+};
+
+#endif // _RDS_H
@@ -0,0 +1,139 @@
+#ifndef _RINGBUFFER_H
+#define _RINGBUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+// Fixed-capacity lock-free ring buffer for exactly one producer thread and
+// one consumer thread. Capacity is rounded up to a power of two so indices
+// can run freely and be masked. Producer and consumer indices live on
+// separate cache lines to avoid false sharing between the two threads.
+template <typename T>
+class SpscRingBuffer {
+    public:
+        // Up to two contiguous regions, the second one used when the
+        // requested range wraps around the end of the storage.
+        struct Span {
+            T *first;
+            size_t first_len;
+            T *second;
+            size_t second_len;
+
+            size_t size() const { return first_len + second_len; }
+        };
+
+        explicit SpscRingBuffer(size_t capacity) :
+            head(0),
+            cached_tail(0),
+            tail(0),
+            cached_head(0),
+            high_water(0)
+        {
+            size_t cap = 1;
+            while (cap < capacity) {
+                cap <<= 1;
+            }
+            storage.resize(cap);
+            mask = cap - 1;
+        }
+
+        size_t capacity() const { return storage.size(); }
+
+        // Number of readable items. Exact when called from either end,
+        // a snapshot when called from a third thread.
+        size_t size() const {
+            return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+        }
+
+        // Largest fill level seen since construction or the last reset.
+        size_t high_water_mark() const { return high_water.load(std::memory_order_relaxed); }
+        void reset_high_water_mark() { high_water.store(0, std::memory_order_relaxed); }
+
+        // Producer: reserve up to 'count' free slots. Fill them, then call
+        // commit_write() with the number of items actually written.
+        Span write_spans(size_t count) {
+            size_t h = head.load(std::memory_order_relaxed);
+            size_t free_slots = storage.size() - (h - cached_tail);
+            if (free_slots < count) {
+                cached_tail = tail.load(std::memory_order_acquire);
+                free_slots = storage.size() - (h - cached_tail);
+            }
+            return make_span(h, std::min(count, free_slots));
+        }
+
+        void commit_write(size_t count) {
+            size_t h = head.load(std::memory_order_relaxed) + count;
+            head.store(h, std::memory_order_release);
+
+            size_t fill = h - tail.load(std::memory_order_relaxed);
+            if (fill > high_water.load(std::memory_order_relaxed)) {
+                high_water.store(fill, std::memory_order_relaxed);
+            }
+        }
+
+        // Consumer: peek at up to 'count' readable items. Consume them
+        // with commit_read().
+        Span read_spans(size_t count) {
+            size_t t = tail.load(std::memory_order_relaxed);
+            size_t avail = cached_head - t;
+            if (avail < count) {
+                cached_head = head.load(std::memory_order_acquire);
+                avail = cached_head - t;
+            }
+            return make_span(t, std::min(count, avail));
+        }
+
+        void commit_read(size_t count) {
+            tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+        }
+
+        // Bulk copy helpers built on the span interface. They return the
+        // number of items actually transferred.
+        size_t write(const T *data, size_t count) {
+            Span span = write_spans(count);
+            std::copy(data, data + span.first_len, span.first);
+            std::copy(data + span.first_len, data + span.size(), span.second);
+            commit_write(span.size());
+            return span.size();
+        }
+
+        size_t read(T *data, size_t count) {
+            Span span = read_spans(count);
+            std::copy(span.first, span.first + span.first_len, data);
+            std::copy(span.second, span.second + span.second_len, data + span.first_len);
+            commit_read(span.size());
+            return span.size();
+        }
+
+    private:
+        static const size_t CACHE_LINE = 64;
+
+        Span make_span(size_t index, size_t count) {
+            size_t offset = index & mask;
+            size_t first_len = std::min(count, storage.size() - offset);
+            Span span;
+            span.first = storage.data() + offset;
+            span.first_len = first_len;
+            span.second = storage.data();
+            span.second_len = count - first_len;
+            return span;
+        }
+
+        // Producer side
+        std::atomic<size_t> head;
+        size_t cached_tail;
+        char pad0[CACHE_LINE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+        // Consumer side
+        std::atomic<size_t> tail;
+        size_t cached_head;
+        char pad1[CACHE_LINE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+        std::atomic<size_t> high_water;
+        std::vector<T> storage;
+        size_t mask;
+};
+
+#endif // _RINGBUFFER_H
@@ -3,7 +3,6 @@
 #include <complex>
 #include <rtl-sdr.h>
 #include <liquid/liquid.h>
-#include <lame/lame.h>
 #include <shout/shout.h>
 #include <cmath>
 #include <thread>
@@ -12,10 +11,27 @@
 #include <chrono>
 #include <mutex>
 #include <deque>
+#include <memory>
 #include <iomanip>
+#include <cstring>
 #include <fcntl.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 #include "config.h"
 #include "scanner.h"
+#include "ringbuffer.h"
+#include "iq_convert.h"
+#include "dsp_pipeline.h"
+#include "iq_block_ring.h"
+#include "input_source.h"
+#include "audio_encoder.h"
+#include "latency.h"
+#include "metrics.h"
+#include "notifier.h"
+#include "mp3_queue.h"
+#include "icecast_sender.h"
 
 // Global configuration
 Config g_config;
@@ -29,58 +45,165 @@ enum class FMMode {
 // Quiet mode
 bool quiet = false;
 
-// Global RTL-SDR device pointer
-rtlsdr_dev_t *g_dev = nullptr;
+// IQ input: the RTL-SDR dongle or a replayed recording
+InputSource *g_input = nullptr;
 
 Scanner *scanner = nullptr;
-
-// Squelch state
-std::atomic<bool> squelch_active{false};
-std::chrono::steady_clock::time_point last_signal_above_threshold;
-
-// Audio filter state
-iirfilt_rrrf lowcut_filter = nullptr;  // Low-cut filter
+PassbandScanner *pscanner = nullptr;  // Set for [scanner] mode = passband
 
 #define SAMPLE_RATE 1024000  // 1.024 MHz
 #define AUDIO_RATE 48000     // 48 kHz
 #define CENTER_FREQ 99.9e6   // 99.9 MHz
 #define RTL_READ_SIZE (16 * 16384)
-
-#define NFM_DEVIATION 12500    
-#define NFM_FILTER_BW 12500*2  
-
-#define WFM_DEVIATION 75000   // 75 kHz for WBFM
-#define WFM_FILTER_BW 120000  // 120 kHz for WFM
-
-#define AM_FILTER_BW  8000    // 8 kHz for AM
+#define RTL_READ_SIZE_LOW_LATENCY (2 * 16384)  // 16 ms at 1.024 MS/s
 
 #define AUDIO_BUFFER_IN_SECONDS 2
-#define CHUNK_SIZE (AUDIO_RATE * AUDIO_BUFFER_IN_SECONDS)  // 10 seconds of audio
-#define MP3_BUFFER_SIZE (CHUNK_SIZE * 2)  // Plenty of space for MP3 data
+#define AUDIO_RING_CHUNKS 4  // Demod->encoder ring capacity in chunks (pre-buffer needs 2)
+#define LOW_LATENCY_PREBUFFER_MS 250
+#define MP3_QUEUE_SECONDS 2  // MP3 queue holds at least this much audio
+#define WAKEUP_TIMEOUT_MS 100  // Longest a waiting thread sleeps without a notification
 
 std::atomic<bool> running{true};
-std::atomic<bool> icecast_connected{false};  // Track Icecast connection state
-std::mutex buffer_mutex;
-std::deque<float> audio_buffer;  // Growing buffer for audio samples
+IqBlockRing *iq_blocks = nullptr;   // USB callback -> DSP threads handoff, one consumer per channel
+std::atomic<uint64_t> input_samples{0};  // IQ samples delivered by the input, dropped ones included
+Notifier iq_ready;                  // A block was pushed to iq_blocks, or the input ended
+Notifier iq_space;                  // A DSP thread released a block (recordings only)
+Notifier frames_ready;              // An encoder queued a chunk for the Icecast event loop
 std::chrono::steady_clock::time_point last_stats_time;
-msresamp_rrrf resampler;  // Make resampler global so callback can access it
-std::complex<float> prev_sample(1.0f, 0.0f);  // Make prev_sample global for the callback
-iirfilt_crcf filter;  // FM channel filter
-ModulationMode current_mode = ModulationMode::WFM_MODE; // Default to wide FM
 
-// Structure to hold MP3 data
-struct MP3Chunk {
-    std::vector<unsigned char> data;
-    size_t size;
+// Sizes derived from the configuration and input at startup
+size_t iq_block_size = RTL_READ_SIZE;      // Bytes per USB transfer and IQ block
+size_t iq_sample_size = 2;                 // Bytes per I/Q sample, 8 for cf32 recordings
+
+// Marks where a block's audio starts in the channel's audio stream, so
+// the encoder can tell when the samples of a chunk arrived as IQ
+struct AudioStamp {
+    uint64_t audio_sample;                          // Counting samples dropped on overrun
+    std::chrono::steady_clock::time_point arrival;  // IQ block pushed by the USB callback
+    std::chrono::steady_clock::time_point produced; // Audio written to the ring
 };
 
-std::mutex mp3_buffer_mutex;
-std::deque<MP3Chunk> mp3_queue;
-const size_t MAX_MP3_QUEUE_SIZE = 10;  // Maximum number of MP3 chunks to queue
+// Stages a sample passes from the USB callback to shout_send
+enum LatencyStage {
+    LAT_IQ_QUEUE,   // Waiting in the IQ block pool
+    LAT_DSP,        // Mixer, filter, demodulator and resampler for one block
+    LAT_AUDIO,      // Waiting in the audio ring until its chunk is encoded
+    LAT_ENCODE,     // LAME, or cached silent frames
+    LAT_MP3_QUEUE,  // Waiting in the MP3 queue
+    LAT_TOTAL,      // IQ arrival to shout_send, first sample of each chunk
+    LAT_STAGES
+};
+
+const char *latency_stage_names[LAT_STAGES] = {"IQ", "DSP", "Audio", "Encode", "Queue", "Total"};
+
+const size_t MAX_MP3_QUEUE_SIZE = 10;  // Minimum number of MP3 chunks to queue
+
+// Retune handed from the scanner to a channel's DSP thread, which applies
+// it between blocks so frequency, mode and filter state change together
+struct RetuneRequest {
+    uint32_t freq_hz;
+    ModulationMode mode;
+    std::string name;
+    std::chrono::steady_clock::time_point requested;
+};
+
+// One Icecast server a channel is sent to. Each has its own frame queue,
+// so a slow or unreachable server only fills its own backlog.
+struct ChannelOutput {
+    const IcecastOutputConfig *cfg;
+    Mp3FrameQueue *queue;                 // Encoder -> Icecast event loop handoff
+    IcecastSender *sender;                // Run by the Icecast event loop
+    bool overflowing;                     // Encoder: chunks being dropped at the queue
+    uint64_t drops_seen;                  // Encoder: queue drops as of the previous chunk
+    bool was_connected;                   // Event loop: metadata is sent on connect
+    std::string rds_sent;                 // Event loop: RDS text of the last metadata update
+    std::chrono::steady_clock::time_point last_metadata_update;  // Event loop
+
+    ChannelOutput() :
+        cfg(nullptr),
+        queue(nullptr),
+        sender(nullptr),
+        overflowing(false),
+        drops_seen(0),
+        was_connected(false)
+    {}
+};
+
+// One received channel with its own receive chain, encoder and Icecast
+// outputs. Each channel runs a DSP and an encoder thread, so channels
+// scale across cores; one event loop streams every channel's outputs.
+struct Channel {
+    ChannelConfig cfg;
+    size_t index;                         // Consumer index in iq_blocks
+    DspPipeline *pipeline;                // Receive chain, run by the DSP thread
+    SpscRingBuffer<float> *audio_buffer;  // Demod->encoder handoff, written only by the DSP thread
+    SpscRingBuffer<AudioStamp> *audio_stamps;  // One per block written to audio_buffer
+    Notifier audio_ready;                 // A full chunk is buffered, or the DSP thread finished
+    Notifier audio_space;                 // The encoder took audio from the ring
+    LatencyHistogram latency[LAT_STAGES];
+    std::atomic<size_t> audio_overruns;   // Samples dropped because the ring was full
+    std::atomic<uint64_t> dsp_blocks;     // IQ blocks run through the pipeline
+    std::atomic<uint64_t> dsp_iq_samples;
+    std::atomic<uint64_t> dsp_audio_samples;
+    std::atomic<double> dsp_seconds;      // Time spent in the pipeline
+    std::atomic<bool> dsp_finished;       // Recording fully processed
+    std::atomic<bool> encoder_finished;   // Last full chunk of the recording encoded
+    std::atomic<uint64_t> encoded_samples;
+    std::atomic<uint64_t> codec_chunks;   // Chunks run through the codec
+    std::atomic<uint64_t> silent_chunks;  // Chunks replaced by cached silent frames
+    std::atomic<double> encode_seconds;   // Time spent in the codec
+    std::atomic<bool> squelch_active;
+    std::atomic<float> signal_strength;
+    AudioEncoder *encoder;                // MP3 or Opus, run by the encoder thread
+    size_t chunk_size;                    // Audio samples per encoder call, interleaved
+    size_t prebuffer_samples;             // Audio buffered before encoding starts
+    size_t queue_depth;                   // Chunks queued per Icecast output
+    std::vector<ChannelOutput> outputs;   // One per g_config.icecast_outputs entry
+    std::mutex retune_mutex;
+    RetuneRequest retune;                 // Guarded by retune_mutex
+    std::atomic<bool> retune_pending;
+    uint64_t discard_before_seq;          // DSP thread: first IQ block captured after the last retune
+    bool awaiting_audio;                  // DSP thread: retune latency not measured yet
+    std::chrono::steady_clock::time_point retune_requested;
+    std::atomic<float> retune_latency_ms;      // Last retune to first valid audio
+    std::atomic<float> retune_latency_max_ms;
+    std::thread dsp_thread;
+    std::thread encoder_thread;
+
+    Channel(const ChannelConfig &cfg, size_t index) :
+        cfg(cfg),
+        index(index),
+        pipeline(nullptr),
+        audio_buffer(nullptr),
+        audio_stamps(nullptr),
+        audio_overruns(0),
+        dsp_blocks(0),
+        dsp_iq_samples(0),
+        dsp_audio_samples(0),
+        dsp_seconds(0.0),
+        dsp_finished(false),
+        encoder_finished(false),
+        encoded_samples(0),
+        codec_chunks(0),
+        silent_chunks(0),
+        encode_seconds(0.0),
+        squelch_active(false),
+        signal_strength(0.0f),
+        encoder(nullptr),
+        chunk_size(0),
+        prebuffer_samples(0),
+        queue_depth(0),
+        retune_pending(false),
+        discard_before_seq(0),
+        awaiting_audio(false),
+        retune_latency_ms(0.0f),
+        retune_latency_max_ms(0.0f)
+    {}
+};
+
+std::vector<std::unique_ptr<Channel>> channels;
 
 // Status tracking
-std::atomic<size_t> last_packet_size{0};
-std::atomic<float> signal_strength{0.0f};
 std::mutex status_mutex;
 struct StatusInfo {
     float buffer_seconds{0};
@@ -90,14 +213,20 @@ struct StatusInfo {
 };
 StatusInfo current_status;
 
-// Timestamp for metadata updates
-std::chrono::steady_clock::time_point last_metadata_update;
+// Metadata update period
 const int METADATA_UPDATE_INTERVAL_SEC = 10; // Update metadata every 10 seconds
 
 void signal_handler(int sig) {
     if (sig == SIGPIPE) {
         std::cerr << "Caught SIGPIPE - connection broken\n";
-        icecast_connected = false;  // Mark connection as broken
+        // Mark connections as broken, the event loop reconnects
+        for (size_t i = 0; i < channels.size(); i++) {
+            for (size_t o = 0; o < channels[i]->outputs.size(); o++) {
+                if (channels[i]->outputs[o].sender) {
+                    channels[i]->outputs[o].sender->mark_broken();
+                }
+            }
+        }
     } else if (sig == SIGINT) {
         std::cout << "Caught SIGINT - shutting down\n";
         running = false;
@@ -107,180 +236,12 @@ void signal_handler(int sig) {
     }
 }
 
-// Advanced FM demodulator with phase unwrapping, DC blocking and de-emphasis
-class FMDemodulator {
-private:
-    std::complex<float> prev_sample;
-    float prev_demod;
-    float dc_block_alpha;
-    float dc_avg;
-    float deemph_alpha;
-    float deemph_prev;
-    bool use_deemphasis;
-    float deviation;
-    float sample_rate;
-    
-public:
-    FMDemodulator() : 
-        prev_sample(1.0f, 0.0f),
-        prev_demod(0.0f),
-        dc_block_alpha(0.01f),
-        dc_avg(0.0f),
-        deemph_alpha(0.0f),
-        deemph_prev(0.0f),
-        use_deemphasis(true),
-        deviation(WFM_DEVIATION),
-        sample_rate(SAMPLE_RATE) {
-        // Initialize de-emphasis filter
-        // Time constant is 75µs for US FM broadcasts, 50µs for Europe
-        // For 75 µs (used in North America), the cutoff frequency is ~2.12 kHz.
-        // For 50 µs (used in Europe), the cutoff frequency is ~3.18 kHz.
-        float time_constant = 75e-6f; // 75µs for US
-        deemph_alpha = 1.0f - expf(-1.0f / (time_constant * sample_rate));
-    }
-    
-    void setMode(ModulationMode mode, float sampleRate) {
-        deviation = (mode == ModulationMode::WFM_MODE) ? WFM_DEVIATION : NFM_DEVIATION;
-        sample_rate = sampleRate;
-        
-        // Update de-emphasis filter for new sample rate
-        float time_constant = (mode == ModulationMode::WFM_MODE) ? 75e-6f : 50e-6f; // 75µs for WFM, 50µs for NFM
-        deemph_alpha = 1.0f - expf(-1.0f / (time_constant * sample_rate));
-        
-        // Use de-emphasis only for wide FM
-        use_deemphasis = (mode == ModulationMode::NFM_MODE);
-
-    }
-    
-    void reset() {
-        prev_sample = std::complex<float>(1.0f, 0.0f);
-        prev_demod = 0.0f;
-        dc_avg = 0.0f;
-        deemph_prev = 0.0f;
-    }
-    
-    float demodulate(std::complex<float> sample) {
-        // Phase difference demodulation with unwrapping
-        float phase = std::arg(sample * std::conj(prev_sample));
-        
-        // Phase unwrapping for large frequency deviations
-        if (phase > M_PI) phase -= 2.0f * M_PI;
-        else if (phase < -M_PI) phase += 2.0f * M_PI;
-        
-        // Convert phase to audio sample
-        float demod = phase * (sample_rate / (2.0f * M_PI * deviation));
-        
-        // DC blocking filter
-        dc_avg = dc_avg * (1.0f - dc_block_alpha) + demod * dc_block_alpha;
-        float dc_blocked = demod - dc_avg;
-        
-        // De-emphasis filter (1st order IIR low-pass)
-        float result;
-        if (use_deemphasis) {
-            deemph_prev = deemph_prev + deemph_alpha * (dc_blocked - deemph_prev);
-            result = deemph_prev;
-        } else {
-            result = dc_blocked;
-        }
-        
-        // Update state for next sample
-        prev_sample = sample;
-        prev_demod = demod;
-        
-        return result;
-    }
-    
-    // For compatibility with the old interface
-    float demodulate(std::complex<float> prev, std::complex<float> curr) {
-        prev_sample = prev;
-        return demodulate(curr);
-    }
-};
-
-// Global demodulator instance
-FMDemodulator g_demodulator;
-
-// Wrapper function for backward compatibility
-float fm_demod(std::complex<float> prev, std::complex<float> curr) {
-    return g_demodulator.demodulate(prev, curr);
-}
-
-// Initialize modulation mode
-void init_modulation(ModulationMode mode) {
-    current_mode = mode;
-    
-    float cutoff_freq;
-    if (mode == ModulationMode::WFM_MODE) cutoff_freq = WFM_FILTER_BW;
-    else if (mode == ModulationMode::NFM_MODE) cutoff_freq = NFM_FILTER_BW;
-    else cutoff_freq = AM_FILTER_BW;
-
-    float filter_bw = cutoff_freq / (float)g_config.sample_rate;
-    
-    if (filter) {
-        iirfilt_crcf_destroy(filter);
-    }
-    
-    filter = iirfilt_crcf_create_prototype(
-        LIQUID_IIRDES_BUTTER,
-        LIQUID_IIRDES_LOWPASS,
-        LIQUID_IIRDES_SOS,
-        5,
-        filter_bw,
-        0.0f,
-        1.0f,
-        60.0f
-    );
-    
-    if ((mode == ModulationMode::NFM_MODE) || (mode == ModulationMode::WFM_MODE)) {
-        // Initialize the FM demodulator with the new mode
-        g_demodulator.setMode(mode, g_config.sample_rate);
-        g_demodulator.reset();
-        
-        printf("Initialized %s FM mode with %d Hz deviation and %.1f kHz filter\n",
-            (mode == ModulationMode::WFM_MODE) ? "Wide" : "Narrow",
-            (mode == ModulationMode::WFM_MODE) ? WFM_DEVIATION : NFM_DEVIATION,
-            cutoff_freq / 1000.0f);
-    }
-    if (mode == ModulationMode::AM_MODE) {
-        printf("Initialized AM mode with %.1f kHz filter\n", cutoff_freq / 1000.0f);
-    }
-}
-
-// Initialize low-cut filter
-void init_lowcut_filter() {
-    // Clean up existing filter if any
-    if (lowcut_filter) {
-        iirfilt_rrrf_destroy(lowcut_filter);
-        lowcut_filter = nullptr;
-    }
-    
-    if (g_config.lowcut_enabled) {
-        // Calculate normalized cutoff frequency
-        float cutoff_norm = g_config.lowcut_freq / (float)g_config.audio_rate;
-        
-        // Create new filter
-        lowcut_filter = iirfilt_rrrf_create_prototype(
-            LIQUID_IIRDES_BUTTER,      // Butterworth filter type
-            LIQUID_IIRDES_HIGHPASS,    // High-pass filter (low-cut)
-            LIQUID_IIRDES_SOS,         // Second-order sections
-            g_config.lowcut_order,     // Filter order
-            cutoff_norm,               // Normalized cutoff frequency
-            0.0f,                      // Unused for high-pass
-            1.0f,                      // Pass-band ripple (unused for Butterworth)
-            60.0f                      // Stop-band attenuation
-        );
-        
-        printf("Initialized low-cut filter at %.1f Hz (order %d)\n", 
-               g_config.lowcut_freq, g_config.lowcut_order);
-    } else {
-        printf("Low-cut filter disabled\n");
-    }
-}
-
 // Function to toggle low-cut filter
 void toggle_lowcut_filter() {
     g_config.lowcut_enabled = !g_config.lowcut_enabled;
-    init_lowcut_filter();
+    for (size_t i = 0; i < channels.size(); i++) {
+        channels[i]->pipeline->set_lowcut(g_config.lowcut_enabled, g_config.lowcut_freq, g_config.lowcut_order);
+    }
     std::cout << "Low-cut filter " << (g_config.lowcut_enabled ? "enabled" : "disabled") 
               << " (cutoff: " << g_config.lowcut_freq << " Hz)" << std::endl;
 }
@@ -294,140 +255,286 @@ void set_lowcut_frequency(float freq) {
     
     g_config.lowcut_freq = freq;
     if (g_config.lowcut_enabled) {
-        init_lowcut_filter();
+        for (size_t i = 0; i < channels.size(); i++) {
+            channels[i]->pipeline->set_lowcut(g_config.lowcut_enabled, g_config.lowcut_freq, g_config.lowcut_order);
+        }
     }
     std::cout << "Low-cut frequency set to " << freq << " Hz" << std::endl;
 }
 
 
-// Function to check Icecast connection status
-bool check_icecast_connection(shout_t* shout) {
-    if (!shout) {
-        return false;
-    }
-    
-    int err = shout_get_connected(shout);
-    
-    // SHOUTERR_CONNECTED (0) means connected
-    // Any other value means not connected
-    if (err == SHOUTERR_CONNECTED) {
-        return true;
-    }
-    
-    // If we thought we were connected but aren't, update the status
-    if (icecast_connected.load()) {
-        std::cerr << "Icecast connection lost: " << shout_get_error(shout) << std::endl;
-        icecast_connected = false;
+// Convert audio samples to 16-bit PCM, returns the next output position
+short *float_to_pcm(const float *in, size_t count, short *out) {
+    for (size_t i = 0; i < count; i++) {
+        float sample = std::max(-1.0f, std::min(1.0f, in[i]));
+        sample *= 0.7f; // Prevent clipping
+        out[i] = static_cast<short>(sample * 32767.0f);
     }
-    
-    return false;
+    return out + count;
 }
 
-
 // Function to print buffer statistics
-void print_buffer_stats() {
+void print_buffer_stats(Channel &ch) {
     auto now = std::chrono::steady_clock::now();
     if (std::chrono::duration_cast<std::chrono::seconds>(now - last_stats_time).count() >= 1) {
-        std::lock_guard<std::mutex> lock(buffer_mutex);
-        float buffer_seconds = static_cast<float>(audio_buffer.size()) / g_config.audio_rate;
+        float buffer_seconds = static_cast<float>(ch.audio_buffer->size()) / ch.cfg.audio.samples_per_second();
         std::cout << "Buffer size: " << buffer_seconds << " seconds\n";
         last_stats_time = now;
     }
 }
 
-// Callback function to receive IQ samples
+// Callback function to receive IQ samples. Runs on the libusb thread, so
+// it only copies the block into the pool; a full pool drops the block.
 void rtl_callback(unsigned char *buf, uint32_t len, void *) {
-    // Calculate signal strength (RMS of I/Q samples)
-    float sum_squared = 0.0f;
-    std::vector<std::complex<float>> filtered_samples(len/2);
-    
-    // Convert samples and apply filtering
-    for (uint32_t i = 0; i < len; i += 2) {
-        float i_sample = (buf[i] - 127.5f) / 127.5f;
-        float q_sample = (buf[i + 1] - 127.5f) / 127.5f;
-        std::complex<float> sample(i_sample, q_sample);
-        
-        // Apply FM channel filter
-        std::complex<float> filtered;
-        iirfilt_crcf_execute(filter, sample, &filtered);
-        filtered_samples[i/2] = filtered;
-        
-        sum_squared += std::norm(filtered);
-    }
-    
-    float rms = std::sqrt(sum_squared / (len/2));
-    float db = 20 * std::log10(rms + 1e-10);
-    signal_strength.store(db);
-    
-    // Check squelch
-    bool is_squelched = false;
-    if (g_config.squelch_enabled) {
-        auto now = std::chrono::steady_clock::now();
-        if (db >= g_config.squelch_threshold) {
-            // Signal is above threshold, update the timestamp
-            last_signal_above_threshold = now;
-            squelch_active = false;
-        } else {
-            // Check if we're within the hold time
-            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-                now - last_signal_above_threshold).count();
-            if (elapsed > g_config.squelch_hold_time) {
-                squelch_active = true;
-                is_squelched = true;
-            }
+    input_samples.fetch_add(len / iq_sample_size, std::memory_order_relaxed);
+    iq_blocks->push(buf, len);
+    iq_ready.notify();
+}
+
+// Callback for recordings replayed faster than real time: wait for room
+// in the pool instead of dropping, so every sample gets processed
+void file_callback(unsigned char *buf, uint32_t len, void *) {
+    while (running) {
+        uint64_t epoch = iq_space.epoch();
+        if (!iq_blocks->full()) {
+            break;
         }
+        iq_space.wait(epoch, std::chrono::milliseconds(WAKEUP_TIMEOUT_MS));
+    }
+    input_samples.fetch_add(len / iq_sample_size, std::memory_order_relaxed);
+    iq_blocks->push(buf, len);
+    iq_ready.notify();
+}
+
+// Frequency a channel listens on, in MHz
+double channel_freq_mhz(const Channel &ch) {
+    return (g_input->center_freq() + ch.pipeline->offset()) / 1e6;
+}
+
+// Queue a retune for the channel's DSP thread. A newer request replaces
+// one that has not been applied yet.
+void request_retune(Channel &ch, const ScanList &entry) {
+    std::lock_guard<std::mutex> lock(ch.retune_mutex);
+    ch.retune.freq_hz = static_cast<uint32_t>(entry.frequency * 1e6);
+    ch.retune.mode = ConfigParser::parse_mode(entry.modulation_mode);
+    ch.retune.name = entry.ch_name;
+    ch.retune.requested = std::chrono::steady_clock::now();
+    ch.retune_pending.store(true, std::memory_order_release);
+}
+
+// DSP thread, after the input has been retuned: drop filter and demod
+// history, and discard every block captured before the tuner settled
+void flush_after_retune(Channel &ch, std::chrono::steady_clock::time_point requested) {
+    ch.pipeline->reset();
+    // Blocks already queued and the one being captured right now still
+    // hold samples from the old frequency or the PLL settling
+    ch.discard_before_seq = iq_blocks->pushed() + 1;
+    ch.awaiting_audio = true;
+    ch.retune_requested = requested;
+}
+
+// DSP thread: apply a pending retune between two blocks
+void apply_retune(Channel &ch) {
+    RetuneRequest req;
+    {
+        std::lock_guard<std::mutex> lock(ch.retune_mutex);
+        req = ch.retune;
+        ch.retune_pending.store(false, std::memory_order_relaxed);
     }
     
-    // Process IQ samples
-    std::vector<float> demod_buffer(len / 2);
-    for (uint32_t i = 0; i < len/2; i++) {
-        if (current_mode == ModulationMode::AM_MODE) demod_buffer[i] = std::abs(filtered_samples[i]);
-        else demod_buffer[i] = fm_demod(prev_sample, filtered_samples[i]);
-        prev_sample = filtered_samples[i];
+    if (!g_input->set_center_freq(req.freq_hz)) {
+        std::cerr << "Failed to set frequency to " << req.freq_hz / 1e6 << " MHz\n";
+        return;
+    }
+    if (req.mode != ch.pipeline->mode()) {
+        ch.pipeline->set_mode(req.mode);
+    }
+    flush_after_retune(ch, req.requested);
+    if (!quiet) {
+        printf("Tuned to %s %.3f MHz\n", req.name.c_str(), req.freq_hz / 1e6);
+    }
+}
+
+// DSP thread: first valid audio since the last retune
+void record_retune_latency(Channel &ch) {
+    float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - ch.retune_requested).count();
+    ch.retune_latency_ms.store(ms, std::memory_order_relaxed);
+    if (ms > ch.retune_latency_max_ms.load(std::memory_order_relaxed)) {
+        ch.retune_latency_max_ms.store(ms, std::memory_order_relaxed);
+    }
+    ch.awaiting_audio = false;
+}
+
+// DSP thread: done with the oldest block. A recording replayed as fast
+// as possible may be waiting for the slot.
+void release_block(Channel &ch) {
+    iq_blocks->release(ch.index);
+    if (g_input->lossless()) {
+        iq_space.notify();
+    }
+}
+
+// Pin the calling thread to one CPU core, if supported
+void pin_current_thread(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) {
+        std::cerr << "Failed to pin DSP thread to CPU " << cpu << ": error " << err << std::endl;
+    } else {
+        printf("DSP thread pinned to CPU %d\n", cpu);
+    }
+#else
+    std::cerr << "CPU pinning not supported on this platform, ignoring dsp_cpu = " << cpu << std::endl;
+#endif
+}
+
+// Thread function for DSP: filter, demodulate and resample queued IQ
+// blocks for one channel, then hand the audio to its encoder
+void dsp_thread_function(Channel *ch) {
+    printf("Starting DSP thread for channel %s\n", ch->cfg.name.c_str());
+    if (g_config.dsp_cpu >= 0) {
+        pin_current_thread(g_config.dsp_cpu + static_cast<int>(ch->index));
     }
     
-    // Resample to audio rate
-    std::vector<float> resampled_buffer(static_cast<size_t>(2.0f * demod_buffer.size()));  // Extra space for 1% more samples
-    unsigned int num_written;
-    msresamp_rrrf_execute(resampler,
-                         demod_buffer.data(),
-                         demod_buffer.size(),
-                         resampled_buffer.data(),
-                         &num_written);
+    // A recording replayed as fast as possible is never dropped: wait
+    // for the encoder instead
+    bool backpressure = g_input->lossless();
     
-    // Apply low-cut filter if enabled
-    if (g_config.lowcut_enabled && lowcut_filter && !is_squelched) {
-        for (unsigned int i = 0; i < num_written; i++) {
-            float filtered_sample;
-            iirfilt_rrrf_execute(lowcut_filter, resampled_buffer[i], &filtered_sample);
-            resampled_buffer[i] = filtered_sample;
-        }
-    }
+    // Silence streamed while the passband scanner has nothing to listen to
+    size_t max_audio = ch->pipeline->context().max_audio_samples(iq_block_size / iq_sample_size);
+    std::vector<float> silence(max_audio + max_audio % ch->cfg.audio.channels, 0.0f);  // Whole frames
+    uint64_t produced = 0;  // Audio samples handed to the ring, including overruns
     
-    // Add to buffer (apply squelch if needed)
-    {
-        std::lock_guard<std::mutex> lock(buffer_mutex);
-        for (unsigned int i = 0; i < num_written; i++) {
-            // If squelched, add silence instead of the actual sample
-            float sample = is_squelched ? 0.0f : resampled_buffer[i];
-            audio_buffer.push_back(sample);
+    while (running) {
+        if (ch->retune_pending.load(std::memory_order_acquire)) {
+            apply_retune(*ch);
+        }
+        
+        uint64_t epoch = iq_ready.epoch();
+        const IqBlock *block = iq_blocks->peek(ch->index);
+        if (!block) {
+            if (g_input->finished()) {
+                ch->dsp_finished = true;
+                break;
+            }
+            iq_ready.wait(epoch, std::chrono::milliseconds(WAKEUP_TIMEOUT_MS));
+            continue;
+        }
+        
+        // Stale samples from before the last retune
+        if (block->seq < ch->discard_before_seq) {
+            release_block(*ch);
+            continue;
+        }
+        
+        bool listening = !pscanner || pscanner->Listening();
+        AudioStamp stamp;
+        stamp.arrival = block->arrival;
+        auto dsp_start = std::chrono::steady_clock::now();
+        Span<const float> audio = ch->pipeline->process(block->data, block->len);
+        stamp.produced = std::chrono::steady_clock::now();
+        ch->latency[LAT_IQ_QUEUE].record(dsp_start - stamp.arrival);
+        ch->latency[LAT_DSP].record(stamp.produced - dsp_start);
+        ch->dsp_blocks.fetch_add(1, std::memory_order_relaxed);
+        ch->dsp_iq_samples.fetch_add(block->len / iq_sample_size, std::memory_order_relaxed);
+        ch->dsp_audio_samples.fetch_add(audio.size, std::memory_order_relaxed);
+        ch->dsp_seconds.store(ch->dsp_seconds.load(std::memory_order_relaxed) +
+            std::chrono::duration<double>(stamp.produced - dsp_start).count(), std::memory_order_relaxed);
+        if (pscanner) {
+            if (!listening) {
+                audio = Span<const float>(silence.data(), std::min(audio.size, silence.size()));
+            }
+            
+            ScanAction action = pscanner->Feed(block->data, block->len, !ch->pipeline->squelched());
+            if (action == ScanAction::RETUNE) {
+                auto requested = std::chrono::steady_clock::now();
+                g_input->set_center_freq(static_cast<uint32_t>(pscanner->WindowCenter()));
+                flush_after_retune(*ch, requested);
+            } else if (action == ScanAction::LISTEN) {
+                // Same tuning, only the mixer offset and possibly the mode change
+                ModulationMode mode = ConfigParser::parse_mode(pscanner->Active().modulation_mode);
+                if (mode != ch->pipeline->mode()) {
+                    ch->pipeline->set_mode(mode);
+                }
+                ch->pipeline->set_offset(pscanner->ActiveOffset());
+                ch->pipeline->reset();
+                if (!quiet) {
+                    printf("[Scanner] Listening to %s on %.3f MHz\n",
+                           pscanner->Active().ch_name.c_str(), pscanner->Active().frequency);
+                }
+            }
+        }
+        release_block(*ch);
+        ch->signal_strength.store(ch->pipeline->signal_db());
+        ch->squelch_active = ch->pipeline->squelched();
+        
+        // Stamp first, so the encoder never sees audio without its stamp.
+        // A full stamp ring only makes the encoder use an older stamp.
+        stamp.audio_sample = produced;
+        produced += audio.size;
+        if (audio.size) {
+            ch->audio_stamps->write(&stamp, 1);
+        }
+        
+        // Add to buffer, waking the encoder once it has a chunk to take
+        size_t written = 0;
+        while (true) {
+            uint64_t epoch = ch->audio_space.epoch();
+            written += ch->audio_buffer->write(audio.data + written, audio.size - written);
+            if (ch->audio_buffer->size() >= ch->chunk_size) {
+                ch->audio_ready.notify();
+            }
+            if (!backpressure || written == audio.size || !running) {
+                break;
+            }
+            ch->audio_space.wait(epoch, std::chrono::milliseconds(WAKEUP_TIMEOUT_MS));
+        }
+        if (written < audio.size) {
+            ch->audio_overruns += audio.size - written;
+        }
+        if (ch->awaiting_audio) {
+            record_retune_latency(*ch);
         }
     }
+    ch->audio_ready.notify();
+    printf("DSP thread for channel %s ending\n", ch->cfg.name.c_str());
 }
 
-// Thread function for RTL-SDR reading
-void rtl_thread_function(rtlsdr_dev_t *dev) {
-    printf("Starting RTL-SDR thread\n");
-    if (rtlsdr_read_async(dev, rtl_callback, nullptr, 0, RTL_READ_SIZE) < 0) {
-        std::cerr << "Failed to start async reading\n";
+// Thread function for IQ input reading
+void input_thread_function(InputSource *input) {
+    printf("Starting %s input thread\n", input->name());
+    IqBlockCallback cb = input->lossless() ? file_callback : rtl_callback;
+    if (!input->run(cb, nullptr, iq_block_size)) {
         running = false;
     }
-    printf("RTL-SDR thread ending\n");
+    iq_ready.notify();  // DSP threads check finished()
+    printf("%s input thread ending\n", input->name());
+}
+
+// Station name and radiotext from RDS, empty until the name is known
+std::string rds_text(const Channel &ch) {
+    const RdsDecoder *rds = ch.pipeline->rds();
+    if (!rds || ch.pipeline->mode() != ModulationMode::WFM_MODE) {
+        return std::string();
+    }
+    std::string ps = rds->station_name();
+    if (ps.empty()) {
+        return ps;
+    }
+    std::string rt = rds->radiotext();
+    return rt.empty() ? ps : ps + " - " + rt;
 }
 
 // Function to update Icecast metadata
-void update_icecast_metadata(shout_t* shout, double freq_mhz, float signal_db) {
-    if (!shout || !icecast_connected.load()) {
+void update_icecast_metadata(Channel &ch, ChannelOutput &out, double freq_mhz, float signal_db) {
+    std::string rds = rds_text(ch);
+    out.rds_sent = rds;
+    
+    // Icecast only takes metadata updates for MP3 streams
+    if (!out.sender->connected() || out.sender->target().format != SHOUT_FORMAT_MP3) {
         return;
     }
     
@@ -443,216 +550,252 @@ void update_icecast_metadata(shout_t* shout, double freq_mhz, float signal_db) {
     
     // Format mode
     std::string mode;
-    if (current_mode == ModulationMode::AM_MODE) mode = "AM";
-    else if (current_mode == ModulationMode::NFM_MODE) mode = "NFM";
+    if (ch.pipeline->mode() == ModulationMode::AM_MODE) mode = "AM";
+    else if (ch.pipeline->mode() == ModulationMode::NFM_MODE) mode = "NFM";
     else mode = "WFM";
     
     // Create complete title string with mode
     std::string full_title = title + " [" + mode + "]";
     
-    // Try the older API first, as it's more widely supported
-    try {
-        // Create metadata
-        shout_metadata_t *metadata = shout_metadata_new();
-        if (!metadata) {
-            std::cerr << "Failed to create metadata object" << std::endl;
-            return;
-        }
-        
-        // Set artist and title and check return values
-        int ret_artist = shout_metadata_add(metadata, "artist", artist.c_str());
-        int ret_title = shout_metadata_add(metadata, "title", full_title.c_str());
-        
-        if (ret_artist != SHOUTERR_SUCCESS || ret_title != SHOUTERR_SUCCESS) {
-            std::cerr << "Error adding metadata fields" << std::endl;
-            shout_metadata_free(metadata);
-            return;
-        }
-        
-        // Try using the older API first
-        int result = shout_set_metadata(shout, metadata);
-        
-        // Free metadata object
-        shout_metadata_free(metadata);
-        
-        if (result != SHOUTERR_SUCCESS) {
-            std::cerr << "Error updating metadata: " << shout_get_error(shout) << std::endl;
-        } else {
-            if (!quiet) {
-                std::cout << "Updated metadata: " << artist << " - " << full_title << std::endl;
+    // The station's own name, and radiotext instead of the signal, from RDS
+    if (!rds.empty()) {
+        std::string rt = ch.pipeline->rds()->radiotext();
+        artist = ch.pipeline->rds()->station_name();
+        full_title = rt.empty() ? artist_ss.str() : rt;
+    }
+    
+    if (out.sender->set_metadata(artist, full_title) && !quiet) {
+        std::cout << "Updated metadata on " << out.cfg->name << ": " << artist << " - " << full_title << std::endl;
+    }
+}
+
+// Audio rate and bitrates of a channel: the [audio] settings, or with
+// audio_rate = auto the profile of its mode. A scanning channel keeps one
+// rate for every entry, so it takes the widest profile on the scanlist.
+AudioProfile audio_profile(const ChannelConfig &cfg, bool scanning) {
+    AudioProfile profile = (g_config.audio_rate > 0) ?
+        AudioProfile(g_config.audio_rate, g_config.mp3_bitrate, g_config.opus_bitrate) :
+        g_config.audio_profiles[static_cast<int>(cfg.mode)];
+    bool wfm = cfg.mode == ModulationMode::WFM_MODE;
+    if (scanning) {
+        for (size_t i = 0; i < g_config.scanlist.size(); i++) {
+            ModulationMode mode = ConfigParser::parse_mode(g_config.scanlist[i].modulation_mode);
+            const AudioProfile &entry = g_config.audio_profiles[static_cast<int>(mode)];
+            if (g_config.audio_rate == 0 && entry.audio_rate > profile.audio_rate) {
+                profile = entry;
             }
+            wfm = wfm || mode == ModulationMode::WFM_MODE;
         }
-    } catch (...) {
-        std::cerr << "Exception in metadata update" << std::endl;
     }
+    // Stereo stays on for the other modes a scanner tunes to, as mono in both channels
+    profile.channels = (g_config.wfm_stereo && wfm) ? 2 : 1;
+    return profile;
 }
 
-// Function to reconnect to Icecast
-bool reconnect_icecast(shout_t* &shout) {
-    std::cout << "Attempting to reconnect to Icecast...\n";
-    
-    // Close existing connection if any
-    if (shout) {
-        shout_close(shout);
-        shout_free(shout);
-        shout = nullptr;  // Ensure pointer is nullified
+// Icecast connection settings for a channel on one output. Channels from
+// [channels] keep their own mount on every server.
+IcecastTarget icecast_target(const Channel &ch, const IcecastOutputConfig &output) {
+    IcecastTarget target;
+    target.host = output.host;
+    target.port = output.port;
+    target.mount = g_config.channels.empty() ? output.mount : ch.cfg.mount;
+    target.user = output.user;
+    target.password = output.password;
+    // Station name tagged with the channel when several share the dongle
+    target.name = g_config.icecast_station_title;
+    if (channels.size() > 1) {
+        target.name += " - " + ch.cfg.name;
     }
+    target.format = ch.encoder->shout_format();
+    target.header = ch.encoder->stream_header();
+    target.bitrate_kbps = ch.encoder->bitrate_kbps();
+    target.reconnect_attempts = output.reconnect_attempts;
+    target.reconnect_delay_ms = output.reconnect_delay_ms;
+    return target;
+}
+
+// Icecast event loop: runs the sender of every output of every channel.
+// Senders never block on the network, so one thread serves them all and
+// only sleeps until an encoder queues a chunk or the earliest pacing or
+// reconnect deadline. Metadata updates are the one blocking request left.
+void icecast_thread_function() {
+    printf("Starting Icecast event loop for %zu output(s)\n", channels.size() * g_config.icecast_outputs.size());
     
-    // Create new connection
-    shout = shout_new();
-    if (!shout) {
-        std::cerr << "Failed to create new shout instance\n";
-        icecast_connected = false;
-        return false;
-    }
-    
-    // Configure connection
-    shout_set_host(shout, g_config.icecast_host.c_str());
-    shout_set_port(shout, g_config.icecast_port);
-    shout_set_mount(shout, g_config.icecast_mount.c_str());
-    shout_set_user(shout, g_config.icecast_user.c_str());
-    shout_set_password(shout, g_config.icecast_password.c_str());
-    
-    // Use older API calls for better compatibility
-    shout_set_format(shout, SHOUT_FORMAT_MP3);
-    
-    shout_set_protocol(shout, SHOUT_PROTOCOL_HTTP);
-    
-    // Set station name using older API call
-    shout_set_name(shout, g_config.icecast_station_title.c_str());
-    
-    // Use blocking mode for initial connection
-    shout_set_nonblocking(shout, 0);
-    
-    printf("Connecting to Icecast server %s:%d%s...\n", 
-           g_config.icecast_host.c_str(), g_config.icecast_port, g_config.icecast_mount.c_str());
-    
-    int err = shout_open(shout);
-    if (err == SHOUTERR_SUCCESS) {
-        std::cout << "Successfully connected to Icecast\n";
-        icecast_connected = true;
+    while (running) {
+        uint64_t epoch = frames_ready.epoch();
+        std::chrono::milliseconds wait(WAKEUP_TIMEOUT_MS);
         
-        // Set initial metadata
-        uint32_t current_freq = rtlsdr_get_center_freq(g_dev);
-        float current_freq_mhz = current_freq / 1e6;
-        update_icecast_metadata(shout, current_freq_mhz, signal_strength.load());
-        last_metadata_update = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < channels.size(); i++) {
+            Channel &ch = *channels[i];
+            for (size_t o = 0; o < ch.outputs.size(); o++) {
+                ChannelOutput &out = ch.outputs[o];
+                wait = std::min(wait, out.sender->run_once());
+                
+                // Metadata right after connecting, then every METADATA_UPDATE_INTERVAL_SEC
+                // seconds or as soon as the RDS text changes
+                auto now = std::chrono::steady_clock::now();
+                bool connected = out.sender->connected();
+                if (connected && (!out.was_connected || rds_text(ch) != out.rds_sent ||
+                    std::chrono::duration_cast<std::chrono::seconds>(now - out.last_metadata_update).count() >= METADATA_UPDATE_INTERVAL_SEC)) {
+                    if (g_input) {
+                        update_icecast_metadata(ch, out, channel_freq_mhz(ch), ch.signal_strength.load());
+                    }
+                    out.last_metadata_update = now;
+                }
+                out.was_connected = connected;
+            }
+        }
         
-        return true;
+        if (wait.count() > 0) {
+            frames_ready.wait(epoch, wait);
+        }
     }
     
-    std::cerr << "Failed to connect to Icecast: " << shout_get_error(shout) << std::endl;
-    icecast_connected = false;
-    return false;
+    printf("Icecast event loop ending\n");
+}
+
+// Encoder: queue a chunk on one output, reporting when the queue starts
+// overflowing rather than every chunk. Drops since the previous chunk
+// count, since acquire() is where the oldest frame is dropped.
+void queue_chunk(ChannelOutput &out, Mp3FrameQueue::Frame *frame) {
+    out.queue->commit(frame);
+    
+    uint64_t drops = out.queue->dropped_oldest() + out.queue->dropped_newest();
+    bool overflowing = drops != out.drops_seen;
+    out.drops_seen = drops;
+    if (overflowing && !out.overflowing) {
+        std::cerr << "MP3 queue full on " << out.cfg->name << " " << out.sender->target().mount << ", dropping "
+                  << (out.queue->policy() == Mp3Overflow::DROP_OLDEST ? "oldest" : "newest") << " chunks\n";
+    }
+    out.overflowing = overflowing;
 }
 
-// Thread function for Icecast streaming
-void icecast_thread_function(shout_t* shout) {
-    printf("Starting Icecast streaming thread\n");
+// Thread function for audio encoding of one channel
+void encoder_thread_function(Channel *ch) {
+    // Buffers for processing
+    std::vector<short> pcm_buffer(ch->chunk_size);
     
-    int consecutive_errors = 0;
-    const std::chrono::milliseconds reconnect_delay(g_config.reconnect_delay_ms);
-    auto last_connection_check = std::chrono::steady_clock::now();
-    last_metadata_update = std::chrono::steady_clock::now();
+    // Codecs with cached silent frames stream those for chunks the squelch muted
+    bool have_silence = ch->encoder->has_silence();
+    std::deque<SquelchEvent> squelch_events;
+    bool squelch_open = false;     // As of the start of the next chunk
+    uint64_t position = 0;         // Audio samples taken from the ring
+    AudioStamp stamp;              // Block holding the first sample of the next chunk
+    stamp.arrival = stamp.produced = std::chrono::steady_clock::now();
     
-    while (running) {
-        // Periodically check connection status (every 5 seconds)
-        auto now = std::chrono::steady_clock::now();
-        if (std::chrono::duration_cast<std::chrono::seconds>(now - last_connection_check).count() >= 5) {
-            if (icecast_connected.load()) {
-                // Only check if we think we're connected
-                icecast_connected = check_icecast_connection(shout);
-            }
-            last_connection_check = now;
-        }
-        
-        // Check if it's time to update metadata (every METADATA_UPDATE_INTERVAL_SEC seconds)
-        if (icecast_connected.load() && 
-            std::chrono::duration_cast<std::chrono::seconds>(now - last_metadata_update).count() >= METADATA_UPDATE_INTERVAL_SEC) {
-            
-            if (g_dev) {
-                uint32_t current_freq = rtlsdr_get_center_freq(g_dev);
-                float current_freq_mhz = current_freq / 1e6;
-                update_icecast_metadata(shout, current_freq_mhz, signal_strength.load());
-            }
-            last_metadata_update = now;
+    // pre-buffer
+    printf("Pre-buffering %s...\n", ch->cfg.name.c_str());
+    while (running && !ch->dsp_finished) {
+        uint64_t epoch = ch->audio_ready.epoch();
+        if (ch->audio_buffer->size() >= ch->prebuffer_samples) {
+            break; // We have enough samples, exit the loop
         }
+        ch->audio_ready.wait(epoch, std::chrono::milliseconds(WAKEUP_TIMEOUT_MS));
+    }
+    
+    printf("All ready on %s - Let's go!\n", ch->cfg.name.c_str());
+    
+    while (running) 
+    {
+        uint64_t epoch = ch->audio_ready.epoch();
         
-        // Check connection status
-        if (!icecast_connected) {
-            std::cout << "Not connected to Icecast, attempting to reconnect...\n";
-            
-            if (consecutive_errors < g_config.reconnect_attempts) {
-                if (reconnect_icecast(shout)) {
-                    consecutive_errors = 0;
-                } else {
-                    consecutive_errors++;
-                    std::cout << "Reconnection attempt " << consecutive_errors 
-                              << " of " << g_config.reconnect_attempts << " failed\n";
-                    std::this_thread::sleep_for(reconnect_delay);
-                    continue;
-                }
-            } else {
-                std::cerr << "Failed to reconnect after " << g_config.reconnect_attempts 
-                         << " attempts, waiting longer...\n";
-                std::this_thread::sleep_for(std::chrono::seconds(30));
-                consecutive_errors = 0;
-                continue;
+        // Squelch transitions, timestamped in samples of this audio stream.
+        // They are queued before the audio they describe.
+        SquelchEvent event;
+        while (ch->pipeline->squelch_events().read(&event, 1) == 1) {
+            if (!quiet) {
+                printf("[%s] Squelch %s at %.3f s (%.1f dB, noise floor %.1f dB)\n",
+                       ch->cfg.name.c_str(), event.open ? "open" : "closed",
+                       (double)event.audio_sample / ch->cfg.audio.samples_per_second(), event.level_db, event.noise_floor_db);
             }
+            squelch_events.push_back(event);
         }
         
-        // Process MP3 data if connected
-        MP3Chunk chunk;
-        bool have_data = false;
+        // Check if we have enough samples
+        SpscRingBuffer<float>::Span chunk_span = ch->audio_buffer->read_spans(ch->chunk_size);
+        bool have_chunk = chunk_span.size() == ch->chunk_size;
         
-        // Get MP3 data from queue
-        {
-            std::lock_guard<std::mutex> lock(mp3_buffer_mutex);
-            if (!mp3_queue.empty()) {
-                chunk = std::move(mp3_queue.front());
-                mp3_queue.pop_front();
-                have_data = true;
+        if (have_chunk) {
+            // Samples dropped on a full ring never reach the encoder but
+            // count in the pipeline's timestamps
+            uint64_t start = position + ch->audio_overruns.load();
+            uint64_t end = start + ch->chunk_size;
+            while (!squelch_events.empty() && squelch_events.front().audio_sample <= start) {
+                squelch_open = squelch_events.front().open;
+                squelch_events.pop_front();
             }
-        }
-        
-        if (have_data) {
-            // Verify connection before sending
-            if (!check_icecast_connection(shout)) {
-                // Put the chunk back in the queue if there's space
-                std::lock_guard<std::mutex> lock(mp3_buffer_mutex);
-                if (mp3_queue.size() < MAX_MP3_QUEUE_SIZE) {
-                    mp3_queue.push_front(std::move(chunk));
+            bool silent = have_silence && ch->pipeline->squelch()->is_enabled() && !squelch_open &&
+                          (squelch_events.empty() || squelch_events.front().audio_sample >= end);
+            
+            // Latest block starting at or before the chunk
+            while (true) {
+                SpscRingBuffer<AudioStamp>::Span next = ch->audio_stamps->read_spans(1);
+                if (next.size() == 0 || next.first[0].audio_sample > start) {
+                    break;
                 }
-                continue;
+                stamp = next.first[0];
+                ch->audio_stamps->commit_read(1);
             }
+            // Encode straight into a frame of the first output's queue;
+            // with the block policy this waits for its sender
+            Mp3FrameQueue::Frame *frame = ch->outputs[0].queue->acquire(running);
+            auto encode_start = std::chrono::steady_clock::now();
+            ch->latency[LAT_AUDIO].record(encode_start - stamp.produced);
             
-            // Send data
-            last_packet_size.store(0);
-            int ret = shout_send(shout, chunk.data.data(), chunk.size);
-            last_packet_size.store(chunk.size);
-            
-            if (ret == SHOUTERR_SUCCESS) {
-                consecutive_errors = 0;
-                // Wait until it's time to send the next chunk
-                shout_sync(shout);
+            int mp3_size = 0;
+            if (silent) {
+                // Closed for the whole chunk: the codec flushes what it
+                // still holds, then sends cached frames
+                mp3_size = ch->encoder->encode_silence(ch->chunk_size / ch->cfg.audio.channels,
+                                                       frame->data, frame->capacity);
+                ch->audio_buffer->commit_read(ch->chunk_size);
+                ch->silent_chunks++;
             } else {
-                std::cerr << "Icecast error: " << shout_get_error(shout) << std::endl;
-                icecast_connected = false;
-                consecutive_errors++;
+                // Extract chunk and convert to PCM            
+                short *pcm = pcm_buffer.data();
+                pcm = float_to_pcm(chunk_span.first, chunk_span.first_len, pcm);
+                float_to_pcm(chunk_span.second, chunk_span.second_len, pcm);
+                ch->audio_buffer->commit_read(ch->chunk_size);
                 
-                // Put the chunk back in the queue if there's space
-                std::lock_guard<std::mutex> lock(mp3_buffer_mutex);
-                if (mp3_queue.size() < MAX_MP3_QUEUE_SIZE) {
-                    mp3_queue.push_front(std::move(chunk));
-                }
+                mp3_size = ch->encoder->encode(pcm_buffer.data(), ch->chunk_size / ch->cfg.audio.channels,
+                                               frame->data, frame->capacity);
+                
+                ch->encode_seconds.store(ch->encode_seconds.load() +
+                    std::chrono::duration<double>(std::chrono::steady_clock::now() - encode_start).count());
+                ch->codec_chunks++;
+            }
+            position += ch->chunk_size;
+            ch->encoded_samples += ch->chunk_size;
+            ch->audio_space.notify();
+            auto encoded = std::chrono::steady_clock::now();
+            ch->latency[LAT_ENCODE].record(encoded - encode_start);
+            
+            // Add MP3 data to the queues. Further outputs get a copy, made
+            // before the first frame is committed and may be sent.
+            frame->size = std::max(mp3_size, 0);
+            frame->duration = (double)ch->chunk_size / ch->cfg.audio.samples_per_second();
+            frame->arrival = stamp.arrival;
+            frame->queued = encoded;
+            for (size_t o = 1; o < ch->outputs.size(); o++) {
+                Mp3FrameQueue::Frame *copy = ch->outputs[o].queue->acquire(running);
+                copy->size = std::min(frame->size, copy->capacity);
+                memcpy(copy->data, frame->data, copy->size);
+                copy->duration = frame->duration;
+                copy->arrival = frame->arrival;
+                copy->queued = frame->queued;
+                queue_chunk(ch->outputs[o], copy);
             }
+            queue_chunk(ch->outputs[0], frame);
+            frames_ready.notify();
+        } else if (ch->dsp_finished) {
+            // End of the recording, every full chunk has been encoded
+            break;
         } else {
-            // No data available, wait a bit
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            // Sleep until the DSP thread has a chunk ready
+            ch->audio_ready.wait(epoch, std::chrono::milliseconds(WAKEUP_TIMEOUT_MS));
         }
     }
-    
-    printf("Icecast streaming thread ending\n");
+    ch->encoder_finished = true;
 }
 
 std::string get_mode_text(ModulationMode mode) {
@@ -662,37 +805,38 @@ std::string get_mode_text(ModulationMode mode) {
 }
 
 // Function to print status information
-void print_status() {
+void print_status(Channel &ch) {
     // Get audio buffer info
-    float buffer_seconds;
-    {
-        std::lock_guard<std::mutex> lock(buffer_mutex);
-        buffer_seconds = static_cast<float>(audio_buffer.size()) / g_config.audio_rate;
-    }
+    float buffer_seconds = static_cast<float>(ch.audio_buffer->size()) / ch.cfg.audio.samples_per_second();
+    float buffer_hwm_seconds = static_cast<float>(ch.audio_buffer->high_water_mark()) / ch.cfg.audio.samples_per_second();
     
-    // Get MP3 queue info
-    size_t queue_size;
-    {
-        std::lock_guard<std::mutex> lock(mp3_buffer_mutex);
-        queue_size = mp3_queue.size();
+    // Get MP3 queue info, the longest backlog of any output
+    size_t queue_frames = 0;
+    for (size_t o = 0; o < ch.outputs.size(); o++) {
+        queue_frames = std::max(queue_frames, ch.outputs[o].queue->size());
     }
     
-    float signal_db = signal_strength.load();
-    size_t packet = last_packet_size.load();
+    // Delay from antenna to Icecast: queued IQ blocks, demodulated audio
+    // waiting for the encoder and MP3 data waiting to be sent
+    float delay_seconds = static_cast<float>(iq_blocks->pending(ch.index) * (iq_block_size / iq_sample_size)) / g_config.sample_rate
+                        + buffer_seconds
+                        + queue_frames * static_cast<float>(ch.chunk_size) / ch.cfg.audio.samples_per_second();
+    
+    float signal_db = ch.signal_strength.load();
+    size_t packet = ch.outputs[0].sender->last_frame_size();
     
-    // Get current frequency from the device
-    uint32_t current_freq = 0;
-    if (g_dev) {
-        current_freq = rtlsdr_get_center_freq(g_dev);
+    // Get current channel frequency from the device
+    float current_freq_mhz = 0.0f;
+    if (g_input) {
+        current_freq_mhz = channel_freq_mhz(ch);
     }
-    float current_freq_mhz = current_freq / 1e6;
     
     std::string signalBar = std::string(std::max(0, static_cast<int>((signal_db + 30) / 1.9375)), '#') + std::string(16 - std::max(0, static_cast<int>((signal_db + 30) / 1.9375)), ' ');
     
     // Add squelch indicator
     std::string squelchStatus;
-    if (g_config.squelch_enabled) {
-        squelchStatus = squelch_active ? "MUTED" : "OPEN";
+    if (ch.cfg.squelch_enabled) {
+        squelchStatus = ch.squelch_active ? "MUTED" : "OPEN";
     } else {
         squelchStatus = "OFF";
     }
@@ -705,40 +849,217 @@ void print_status() {
         filterStatus = "OFF";
     }
     
-    // Add Icecast connection status with more detail
-    std::string connectionStatus;
-    if (icecast_connected.load()) {
-        connectionStatus = "Connected";
-    } else {
-        connectionStatus = "Disconnected";
+    // Stereo pilot and RDS station, or the AM detector and AGC
+    std::string modeStatus;
+    if (ch.pipeline->mode() == ModulationMode::WFM_MODE) {
+        if (ch.cfg.audio.channels == 2) {
+            modeStatus = ch.pipeline->pilot_locked() ? "Stereo | " : "Mono | ";
+        }
+        const RdsDecoder *rds = ch.pipeline->rds();
+        if (rds) {
+            std::string ps = rds->station_name();
+            modeStatus += "RDS: " + (rds->synced() ? (ps.empty() ? std::string("sync") : ps) : std::string("-")) + " | ";
+        }
+    } else if (ch.pipeline->mode() == ModulationMode::AM_MODE) {
+        char gain[32];
+        snprintf(gain, sizeof(gain), "AGC: %+.0f dB | ", ch.pipeline->am_gain_db());
+        if (g_config.am_detector == "sync") {
+            modeStatus = ch.pipeline->carrier_locked() ? "Sync | " : "Sync: no lock | ";
+        }
+        modeStatus += g_config.am_agc ? gain : "";
     }
-
-    static int disconnectedCounter=0;
-    if (packet > 0) {
-        disconnectedCounter=0;
-    } else {
-        disconnectedCounter++;
+    
+    // Add Icecast connection and queue status per output, named when
+    // there are several
+    std::string connectionStatus;
+    std::string queueStatus;
+    for (size_t o = 0; o < ch.outputs.size(); o++) {
+        const ChannelOutput &out = ch.outputs[o];
+        std::string prefix = (o ? ", " : "") + (ch.outputs.size() > 1 ? out.cfg->name + " " : std::string());
+        
+        connectionStatus += prefix + out.sender->status_text();
+        if (out.sender->discarded()) {
+            connectionStatus += " (discarded " + std::to_string(out.sender->discarded()) + " while down)";
+        }
+        
+        queueStatus += prefix + std::to_string(out.queue->size()) + "/" + std::to_string(out.queue->depth());
+        uint64_t queue_drops = out.queue->dropped_oldest() + out.queue->dropped_newest();
+        if (queue_drops) {
+            queueStatus += " (dropped " + std::to_string(queue_drops) + ")";
+        }
     }
-
-    if (disconnectedCounter > 2) 
-    {        
-        icecast_connected = false;
+    
+    // Idle path: blocks and chunks skipped while squelched, and the CPU
+    // time they would have taken at the measured per-block cost
+    std::string idleStatus;
+    if (ch.cfg.squelch_enabled) {
+        uint64_t active = ch.pipeline->active_blocks();
+        uint64_t idle = ch.pipeline->idle_blocks();
+        uint64_t codec_chunks = ch.codec_chunks.load();
+        double saved = 0.0;
+        if (active) {
+            saved += idle * ch.pipeline->demod_seconds() / active;
+        }
+        if (codec_chunks) {
+            saved += ch.silent_chunks.load() * ch.encode_seconds.load() / codec_chunks;
+        }
+        std::stringstream idle_ss;
+        idle_ss << std::fixed << std::setprecision(1) << "Idle: "
+                << (active + idle ? 100.0 * idle / (active + idle) : 0.0) << "% (CPU saved " << saved << "s) | ";
+        idleStatus = idle_ss.str();
     }
     
-    // Add queue status
-    std::string queueStatus = std::to_string(queue_size) + "/" + std::to_string(MAX_MP3_QUEUE_SIZE);
+    // Passband scan rate, entries measured per second since the last status
+    std::string scanStatus;
+    if (pscanner) {
+        static uint64_t last_measured = 0;
+        uint64_t measured = pscanner->Measured();
+        scanStatus = "Scan: " + std::to_string(measured - last_measured) + " ch/s | ";
+        last_measured = measured;
+    }
+    if (g_config.scanEnabled) {
+        std::stringstream retune_ss;
+        retune_ss << std::fixed << std::setprecision(0) << "Retune: " << ch.retune_latency_ms.load()
+                  << " ms (max " << ch.retune_latency_max_ms.load() << " ms) | ";
+        scanStatus += retune_ss.str();
+    }
 
     std::cout << std::fixed << std::setprecision(3)
                 <<"[rtl_icecast] "
+                << (channels.size() > 1 ? ch.cfg.name + " " : std::string())
                 << current_freq_mhz << " MHz | "
-                << get_mode_text(current_mode) << " | "
-                << "Squelch: " << squelchStatus << " | "                
-                << "Buffer: " << buffer_seconds << "s | "
+                << get_mode_text(ch.pipeline->mode()) << " | "
+                << modeStatus
+                << "Squelch: " << squelchStatus << " | "
+                << idleStatus
+                << scanStatus
+                << "Delay: " << delay_seconds << "s | "
+                << "Buffer: " << buffer_seconds << "s (max " << buffer_hwm_seconds << "s"
+                << (ch.audio_overruns.load() ? ", overruns " + std::to_string(ch.audio_overruns.load()) : "") << ") | "
+                << "Allocs: " << ch.pipeline->context().hot_path_allocations() << " | "
+                << "USB drops: " << iq_blocks->dropped() << " | "
                 << "Signal: [" << signalBar << "] " << signal_db << " dB | "
                 << "mp3-Queue: " << queueStatus << " | "
                 << "Last: " << packet << " bytes | "
                 << connectionStatus 
                 << std::endl;
+    
+    // Per-stage latency since start, p50/p99/max in milliseconds
+    std::cout << "  Latency ms (p50/p99/max):";
+    for (int i = 0; i < LAT_STAGES; i++) {
+        std::cout << " " << latency_stage_names[i] << " " << ch.latency[i].summary_ms();
+    }
+    std::cout << std::endl;
+}
+
+// One sample per channel of a metric family
+template <typename F>
+void channel_metric(MetricsText &m, const char *name, const char *type, const char *help, F value) {
+    m.family(name, type, help);
+    for (size_t i = 0; i < channels.size(); i++) {
+        m.sample(name, MetricsText::label("channel", channels[i]->cfg.name), value(*channels[i]));
+    }
+}
+
+// One sample per output of every channel
+template <typename F>
+void output_metric(MetricsText &m, const char *name, const char *type, const char *help, F value) {
+    m.family(name, type, help);
+    for (size_t i = 0; i < channels.size(); i++) {
+        for (size_t o = 0; o < channels[i]->outputs.size(); o++) {
+            const ChannelOutput &out = channels[i]->outputs[o];
+            m.sample(name, MetricsText::label("channel", channels[i]->cfg.name) + "," +
+                           MetricsText::label("output", out.cfg->name), value(out));
+        }
+    }
+}
+
+// Prometheus scrape, run on the metrics server thread
+void collect_metrics(MetricsText &m) {
+    m.family("rtl_icecast_input_samples_total", "counter", "IQ samples delivered by the input");
+    m.sample("rtl_icecast_input_samples_total", "", input_samples.load());
+    m.family("rtl_icecast_usb_dropped_blocks_total", "counter", "IQ blocks dropped because the block pool was full");
+    m.sample("rtl_icecast_usb_dropped_blocks_total", "", iq_blocks->dropped());
+    
+    channel_metric(m, "rtl_icecast_dsp_blocks_total", "counter", "IQ blocks run through the receive chain",
+        [](Channel &ch) -> uint64_t { return ch.dsp_blocks.load(); });
+    channel_metric(m, "rtl_icecast_dsp_iq_samples_total", "counter", "IQ samples into the receive chain",
+        [](Channel &ch) -> uint64_t { return ch.dsp_iq_samples.load(); });
+    channel_metric(m, "rtl_icecast_dsp_audio_samples_total", "counter", "Audio samples out of the receive chain",
+        [](Channel &ch) -> uint64_t { return ch.dsp_audio_samples.load(); });
+    channel_metric(m, "rtl_icecast_dsp_seconds_total", "counter", "Time spent in the receive chain",
+        [](Channel &ch) -> double { return ch.dsp_seconds.load(); });
+    channel_metric(m, "rtl_icecast_audio_overrun_samples_total", "counter", "Audio samples dropped because the encoder fell behind",
+        [](Channel &ch) -> uint64_t { return ch.audio_overruns.load(); });
+    channel_metric(m, "rtl_icecast_audio_rate_hz", "gauge", "Channel audio sample rate",
+        [](Channel &ch) -> uint64_t { return ch.cfg.audio.audio_rate; });
+    channel_metric(m, "rtl_icecast_audio_channels", "gauge", "Channel audio channels, 2 for stereo",
+        [](Channel &ch) -> uint64_t { return ch.cfg.audio.channels; });
+    channel_metric(m, "rtl_icecast_audio_buffer_seconds", "gauge", "Audio waiting for the encoder",
+        [](Channel &ch) -> double { return (double)ch.audio_buffer->size() / ch.cfg.audio.samples_per_second(); });
+    channel_metric(m, "rtl_icecast_stereo_pilot_locked", "gauge", "1 while the 19 kHz stereo pilot is locked",
+        [](Channel &ch) -> uint64_t { return ch.pipeline->pilot_locked() ? 1 : 0; });
+    channel_metric(m, "rtl_icecast_am_agc_gain_db", "gauge", "AM AGC gain, 0 unless AM",
+        [](Channel &ch) -> double { return ch.pipeline->am_gain_db(); });
+    channel_metric(m, "rtl_icecast_am_carrier_locked", "gauge", "1 while the AM sync detector's PLL holds the carrier",
+        [](Channel &ch) -> uint64_t { return ch.pipeline->carrier_locked() ? 1 : 0; });
+    channel_metric(m, "rtl_icecast_rds_groups_total", "counter", "RDS groups decoded",
+        [](Channel &ch) -> uint64_t { return ch.pipeline->rds() ? ch.pipeline->rds()->groups() : 0; });
+    channel_metric(m, "rtl_icecast_rds_block_errors_total", "counter", "RDS blocks with a bad checkword while synced",
+        [](Channel &ch) -> uint64_t { return ch.pipeline->rds() ? ch.pipeline->rds()->block_errors() : 0; });
+    channel_metric(m, "rtl_icecast_encoded_samples_total", "counter", "Audio samples into the audio encoder",
+        [](Channel &ch) -> uint64_t { return ch.encoded_samples.load(); });
+    channel_metric(m, "rtl_icecast_encode_seconds_total", "counter", "Time spent in the audio codec",
+        [](Channel &ch) -> double { return ch.encode_seconds.load(); });
+    channel_metric(m, "rtl_icecast_silent_chunks_total", "counter", "Chunks sent as cached silent frames",
+        [](Channel &ch) -> uint64_t { return ch.silent_chunks.load(); });
+    output_metric(m, "rtl_icecast_mp3_queue_chunks", "gauge", "MP3 chunks waiting to be sent",
+        [](const ChannelOutput &out) -> uint64_t { return out.queue->size(); });
+    m.family("rtl_icecast_mp3_queue_drops_total", "counter", "MP3 chunks dropped because the queue was full, by which end");
+    for (size_t i = 0; i < channels.size(); i++) {
+        for (size_t o = 0; o < channels[i]->outputs.size(); o++) {
+            const ChannelOutput &out = channels[i]->outputs[o];
+            std::string labels = MetricsText::label("channel", channels[i]->cfg.name) + "," +
+                                 MetricsText::label("output", out.cfg->name);
+            m.sample("rtl_icecast_mp3_queue_drops_total", labels + ",which=\"oldest\"", out.queue->dropped_oldest());
+            m.sample("rtl_icecast_mp3_queue_drops_total", labels + ",which=\"newest\"", out.queue->dropped_newest());
+        }
+    }
+    output_metric(m, "rtl_icecast_mp3_sent_bytes_total", "counter", "MP3 bytes sent to Icecast",
+        [](const ChannelOutput &out) -> uint64_t { return out.sender->bytes_sent(); });
+    output_metric(m, "rtl_icecast_icecast_reconnects_total", "counter", "Icecast reconnection attempts",
+        [](const ChannelOutput &out) -> uint64_t { return out.sender->reconnects(); });
+    output_metric(m, "rtl_icecast_icecast_discarded_chunks_total", "counter", "MP3 chunks discarded while Icecast was unreachable",
+        [](const ChannelOutput &out) -> uint64_t { return out.sender->discarded(); });
+    output_metric(m, "rtl_icecast_icecast_connected", "gauge", "1 while connected to Icecast",
+        [](const ChannelOutput &out) -> uint64_t { return out.sender->connected() ? 1 : 0; });
+    channel_metric(m, "rtl_icecast_signal_db", "gauge", "Channel signal level in dB",
+        [](Channel &ch) -> double { return ch.signal_strength.load(); });
+    channel_metric(m, "rtl_icecast_squelch_open", "gauge", "1 while the squelch is open or disabled",
+        [](Channel &ch) -> uint64_t { return ch.squelch_active.load() ? 0 : 1; });
+    channel_metric(m, "rtl_icecast_squelch_checked_seconds_total", "counter", "Channel time judged by the squelch",
+        [](Channel &ch) -> double { return ch.pipeline->squelch()->checked_seconds(); });
+    channel_metric(m, "rtl_icecast_squelch_open_seconds_total", "counter", "Channel time the squelch was open",
+        [](Channel &ch) -> double { return ch.pipeline->squelch()->open_seconds(); });
+    channel_metric(m, "rtl_icecast_squelch_duty_cycle", "gauge", "Share of time the squelch was open since start",
+        [](Channel &ch) -> double {
+            double checked = ch.pipeline->squelch()->checked_seconds();
+            return checked > 0.0 ? ch.pipeline->squelch()->open_seconds() / checked : 0.0;
+        });
+    
+    // Latency quantiles per stage; the histograms keep no sum, so these
+    // are gauges rather than a Prometheus summary
+    m.family("rtl_icecast_latency_seconds", "gauge", "Latency per stage since start, by quantile (1 = maximum)");
+    for (size_t i = 0; i < channels.size(); i++) {
+        Channel &ch = *channels[i];
+        for (int stage = 0; stage < LAT_STAGES; stage++) {
+            std::string labels = MetricsText::label("channel", ch.cfg.name) + "," +
+                                 MetricsText::label("stage", latency_stage_names[stage]) + ",";
+            m.sample("rtl_icecast_latency_seconds", labels + "quantile=\"0.5\"", ch.latency[stage].percentile_us(0.50) / 1e6);
+            m.sample("rtl_icecast_latency_seconds", labels + "quantile=\"0.99\"", ch.latency[stage].percentile_us(0.99) / 1e6);
+            m.sample("rtl_icecast_latency_seconds", labels + "quantile=\"1\"", ch.latency[stage].max_us() / 1e6);
+        }
+    }
 }
 
 void print_usage() {
@@ -746,26 +1067,19 @@ void print_usage() {
               << "Options:\n"
               << "  -c, --config <file>    Use specified config file (default: config.ini)\n"
               << "  -q, --quiet            Operate (mostly) quietly (default: false)\n"
+              << "  -i, --input <file>     Replay an IQ recording (cu8, cf32 or SigMF) instead of the RTL-SDR\n"
+              << "  -f, --fast             Replay as fast as possible instead of in real time\n"
               << "  -h, --help             Show this help message\n"
               << std::endl;
 }
 
-// Function to change frequency
-void change_frequency(double new_freq_mhz) {
-    if (!g_dev) return;
-    
-    uint32_t freq_hz = static_cast<uint32_t>(new_freq_mhz * 1e6);
-    if (rtlsdr_set_center_freq(g_dev, freq_hz) < 0) {
-        std::cerr << "Failed to set frequency to " << new_freq_mhz << " MHz\n";
-    } else {
-        g_config.center_freq = new_freq_mhz;
-        std::cout << "Tuned to " << new_freq_mhz << " MHz\n";
-    }
-}
-
 // Function to toggle squelch
 void toggle_squelch() {
     g_config.squelch_enabled = !g_config.squelch_enabled;
+    for (size_t i = 0; i < channels.size(); i++) {
+        channels[i]->cfg.squelch_enabled = g_config.squelch_enabled;
+        channels[i]->pipeline->squelch()->set_enabled(g_config.squelch_enabled);
+    }
     std::cout << "Squelch " << (g_config.squelch_enabled ? "enabled" : "disabled") 
               << " (threshold: " << g_config.squelch_threshold << " dB)" << std::endl;
 }
@@ -773,6 +1087,10 @@ void toggle_squelch() {
 // Function to set squelch threshold
 void set_squelch_threshold(float threshold) {
     g_config.squelch_threshold = threshold;
+    for (size_t i = 0; i < channels.size(); i++) {
+        channels[i]->cfg.squelch_threshold = threshold;
+        channels[i]->pipeline->squelch()->set_threshold(threshold);
+    }
     std::cout << "Squelch threshold set to " << threshold << " dB" << std::endl;
 }
 
@@ -783,6 +1101,8 @@ int main(int argc, char* argv[]) {
     float squelch_level = -30.0f;
     bool force_lowcut = false;
     float lowcut_freq = 300.0f;
+    std::string input_file;
+    bool force_fast = false;
 
     // Parse command line arguments
     for (int i = 1; i < argc; i++) {
@@ -799,7 +1119,16 @@ int main(int argc, char* argv[]) {
                 std::cerr << "Error: Config file path not specified\n";
                 return 1;
             }
-        } 
+        } else if (arg == "-i" || arg == "--input") {
+            if (i + 1 < argc) {
+                input_file = argv[++i];
+            } else {
+                std::cerr << "Error: Input file path not specified\n";
+                return 1;
+            }
+        } else if (arg == "-f" || arg == "--fast") {
+            force_fast = true;
+        }
     }
 
     // Load configuration
@@ -816,6 +1145,13 @@ int main(int argc, char* argv[]) {
             g_config.lowcut_enabled = true;
             g_config.lowcut_freq = lowcut_freq;
         }
+        if (!input_file.empty()) {
+            g_config.input_source = "file";
+            g_config.input_file = input_file;
+        }
+        if (force_fast) {
+            g_config.input_realtime = false;
+        }
     } catch (const std::exception& e) {
         std::cerr << "Error loading config: " << e.what() << std::endl;
         return 1;
@@ -829,230 +1165,300 @@ int main(int argc, char* argv[]) {
     scanner = new Scanner(g_config.scanlist);
     scanner->SetStepDelay(g_config.step_delay_ms);
 
-    // Initialize squelch state
-    last_signal_above_threshold = std::chrono::steady_clock::now();
-    
     // Set up signal handlers
     signal(SIGINT, signal_handler);
     signal(SIGPIPE, signal_handler);
     
     last_stats_time = std::chrono::steady_clock::now();
     
-    // Initialize modulation
-    init_modulation(g_config.mode);
-    
-    // Initialize low-cut filter
-    init_lowcut_filter();
+    // Select IQ conversion kernel
+    IqConvertImpl iq_impl = iq_convert_init(iq_convert_parse(g_config.iq_convert));
+    printf("IQ conversion: %s\n", iq_convert_name(iq_impl));
     
-    // Initialize RTL-SDR
-    if (rtlsdr_open(&g_dev, 0) < 0) {
-        std::cerr << "Failed to open RTL-SDR device\n";
+    // Open the IQ input; a recording may bring its own sample rate
+    if (g_config.input_source == "file") {
+        g_input = new IqFileSource(g_config);
+    } else {
+        g_input = new RtlSdrSource(g_config);
+    }
+    if (!g_input->open()) {
+        delete g_input;
         return 1;
     }
+    g_config.sample_rate = g_input->sample_rate();
+    
+    // Small USB blocks in low-latency mode, so audio leaves the DSP
+    // thread in small steps too
+    if (g_config.low_latency) {
+        iq_block_size = RTL_READ_SIZE_LOW_LATENCY;
+    }
+    // cf32 recordings reach the pipeline as floats, in blocks of as many
+    // samples as a cu8 block holds
+    iq_sample_size = iq_sample_bytes(g_input->sample_format());
+    iq_block_size = iq_block_size / 2 * iq_sample_size;
+    for (size_t o = 0; o < g_config.icecast_outputs.size(); o++) {
+        IcecastOutputConfig &output = g_config.icecast_outputs[o];
+        // One encoder feeds every output, so a blocking queue would let a
+        // dead server stall all the others
+        if (g_config.icecast_outputs.size() > 1 &&
+            Mp3FrameQueue::parse_policy(output.queue_overflow) == Mp3Overflow::BLOCK) {
+            std::cerr << "Icecast output " << output.name << ": queue_overflow = block would stall every output, "
+                      << "using drop_oldest\n";
+            output.queue_overflow = "drop_oldest";
+        }
+        printf("Icecast output %s: %s:%d (%s when full)\n", output.name.c_str(), output.host.c_str(), output.port,
+               Mp3FrameQueue::policy_name(Mp3FrameQueue::parse_policy(output.queue_overflow)));
+    }
+    
+    // Without a [channels] section, receive one channel at the center
+    // frequency with the global mode, squelch and mount
+    std::vector<ChannelConfig> channel_configs = g_config.channels;
+    if (channel_configs.empty()) {
+        ChannelConfig single;
+        single.name = "main";
+        single.mode = g_config.mode;
+        single.squelch_enabled = g_config.squelch_enabled;
+        single.squelch_threshold = g_config.squelch_threshold;
+        single.mount = g_config.icecast_mount;
+        channel_configs.push_back(single);
+    }
+    for (size_t i = 0; i < channel_configs.size(); i++) {
+        if (std::fabs(channel_configs[i].offset_hz) >= g_config.sample_rate / 2.0) {
+            std::cerr << "Channel " << channel_configs[i].name << " offset is outside the "
+                      << g_config.sample_rate / 1000 << " kHz passband\n";
+            delete g_input;
+            return 1;
+        }
+        channels.push_back(std::unique_ptr<Channel>(new Channel(channel_configs[i], i)));
+    }
     
-    // Convert MHz to Hz for the RTL-SDR API
-    uint32_t freq_hz = static_cast<uint32_t>(g_config.center_freq * 1e6);
+    // Retuning moves every channel, so the scanner only drives a single one
+    if (g_config.scanEnabled && channels.size() > 1) {
+        std::cerr << "Scanner disabled: it cannot be combined with multiple channels\n";
+        g_config.scanEnabled = false;
+    }
     
-    // Apply PPM correction if specified
-    if (g_config.ppm_correction != 0) {
-        printf("Setting frequency correction to %d ppm\n", g_config.ppm_correction);
-        rtlsdr_set_freq_correction(g_dev, g_config.ppm_correction);
+    // Passband scanning measures whole windows of the scanlist per block
+    // and only retunes between windows; the squelch ends each listen
+    if (g_config.scanEnabled && g_config.scan_mode == "passband") {
+        pscanner = new PassbandScanner(g_config.scanlist, g_config.sample_rate, g_input->sample_format(),
+                                       channels[0]->cfg.squelch_threshold, g_config.step_delay_ms);
+        channels[0]->cfg.squelch_enabled = true;
+        if (!g_input->set_center_freq(static_cast<uint32_t>(pscanner->WindowCenter()))) {
+            std::cerr << "Failed to tune to the first scan window\n";
+        }
     }
     
-    rtlsdr_set_center_freq(g_dev, freq_hz); 
-    rtlsdr_set_sample_rate(g_dev, g_config.sample_rate);
-    rtlsdr_set_tuner_gain_mode(g_dev, g_config.gain_mode);
-    if (g_config.gain_mode == 1) {
+    shout_init();
+    for (size_t i = 0; i < channels.size(); i++) {
+        Channel &ch = *channels[i];
         
-        int tuner_gains[16];
-        int num_gains = rtlsdr_get_tuner_gains(g_dev, tuner_gains);
-        printf("Allowed gain setting values (1/10 dB): ");
-        for (int i = 0; i < num_gains; i++) {
-            printf("%d ", tuner_gains[i]);
+        // Audio rate and bitrates, from [audio] or the channel's mode
+        ch.cfg.audio = audio_profile(ch.cfg, g_config.scanEnabled && i == 0);
+        
+        // Audio codec picked by icecast_format
+        ch.encoder = new_audio_encoder(g_config, ch.cfg.audio);
+        if (!ch.encoder) {
+            std::cerr << "Unsupported icecast format: " << g_config.icecast_format << "\n";
+            return 1;
+        }
+        if (!ch.encoder->open()) {
+            return 1;
         }
-        printf("\n");   
+        int audio_rate = ch.cfg.audio.audio_rate;
+        size_t audio_channels = ch.cfg.audio.channels;
+        int samples_per_second = ch.cfg.audio.samples_per_second();
         
-        // Set the specified gain or use a default if not specified
-        int gain_to_use = g_config.tuner_gain;
-        if (gain_to_use == 0) {
-            // Default to 9.0 dB (90 tenths of a dB) if not specified
-            gain_to_use = 90;
-            printf("No specific gain value provided, using default: %d.%d dB\n", gain_to_use/10, gain_to_use%10);
+        // Chunking: one codec frame per encoder call in low-latency mode.
+        // Sizes count interleaved samples, so stereo keeps the same duration.
+        if (g_config.low_latency) {
+            ch.chunk_size = ch.encoder->frame_samples() * audio_channels;
         } else {
-            printf("Setting tuner gain to %d.%d dB\n", gain_to_use/10, gain_to_use%10);
+            ch.chunk_size = (size_t)samples_per_second * g_config.audio_buffer_seconds;
         }
+        if (g_config.prebuffer_ms > 0) {
+            ch.prebuffer_samples = (size_t)samples_per_second * g_config.prebuffer_ms / 1000;
+        } else if (g_config.low_latency) {
+            ch.prebuffer_samples = (size_t)samples_per_second * LOW_LATENCY_PREBUFFER_MS / 1000;
+        } else {
+            ch.prebuffer_samples = ch.chunk_size * 2;
+        }
+        ch.prebuffer_samples = std::max(ch.prebuffer_samples, ch.chunk_size) / audio_channels * audio_channels;
+        ch.queue_depth = std::max(MAX_MP3_QUEUE_SIZE, (size_t)samples_per_second * MP3_QUEUE_SECONDS / ch.chunk_size);
+        printf("%s: %s %s at %d Hz, %d kbps, %zu samples per chunk (%.0f ms), pre-buffer %.0f ms, "
+               "queues of %zu chunks\n",
+               ch.cfg.name.c_str(), ch.encoder->name(), audio_channels == 2 ? "stereo" : "mono", audio_rate,
+               ch.encoder->bitrate_kbps(), ch.chunk_size, 1000.0 * ch.chunk_size / samples_per_second,
+               1000.0 * ch.prebuffer_samples / samples_per_second, ch.queue_depth);
+        
+        // Build the receive chain: mixer, channel filter, squelch, demod,
+        // resampler and low-cut filter, with scratch buffers sized for
+        // the USB block length
+        ch.pipeline = new DspPipeline(g_config, ch.cfg, iq_block_size, g_input->sample_format());
+        
+        // Demod->encoder handoff, sized before the input thread starts producing
+        ch.audio_buffer = new SpscRingBuffer<float>(
+            std::max(std::max(ch.chunk_size, (size_t)samples_per_second * AUDIO_BUFFER_IN_SECONDS) * AUDIO_RING_CHUNKS,
+                     ch.prebuffer_samples * 2));
+        // Enough stamps for every block the audio ring can hold
+        size_t block_audio = std::max<size_t>(1, (size_t)((double)iq_block_size / iq_sample_size * samples_per_second / g_config.sample_rate));
+        ch.audio_stamps = new SpscRingBuffer<AudioStamp>(ch.audio_buffer->capacity() / block_audio + 16);
         
-        rtlsdr_set_tuner_gain(g_dev, gain_to_use);
+
+        // Encoder->Icecast handoff per output, frames sized for the
+        // codec's worst case, and its sender, which connects from the event loop
+        ch.outputs.resize(g_config.icecast_outputs.size());
+        for (size_t o = 0; o < ch.outputs.size(); o++) {
+            ChannelOutput &out = ch.outputs[o];
+            out.cfg = &g_config.icecast_outputs[o];
+            out.queue = new Mp3FrameQueue(ch.queue_depth, ch.encoder->max_bytes(ch.chunk_size / audio_channels),
+                                          Mp3FrameQueue::parse_policy(out.cfg->queue_overflow));
+            out.sender = new IcecastSender(icecast_target(ch, *out.cfg), *out.queue);
+            out.sender->set_latency(&ch.latency[LAT_MP3_QUEUE], &ch.latency[LAT_TOTAL]);
+        }
     }
-    rtlsdr_reset_buffer(g_dev);
     
-    // Initialize resampler
-    float resamp_ratio = (float)g_config.audio_rate / g_config.sample_rate * 1.00f;  
-    resampler = msresamp_rrrf_create(resamp_ratio, 60.0f);
+    // Raw IQ block pool between the USB callback and the DSP threads,
+    // every channel reads each block
+    // Smaller low-latency blocks get proportionally more slots
+    iq_blocks = new IqBlockRing(g_config.dsp_queue_blocks * (RTL_READ_SIZE / 2 / (iq_block_size / iq_sample_size)), iq_block_size, channels.size());
     
-    // Initialize LAME
-    lame_t lame = lame_init();
-    lame_set_in_samplerate(lame, g_config.audio_rate);
-    lame_set_out_samplerate(lame, g_config.audio_rate);
-    lame_set_num_channels(lame, 1);
-    lame_set_mode(lame, MONO);
-    lame_set_quality(lame, g_config.mp3_quality);
-    lame_set_brate(lame, g_config.mp3_bitrate);
-    lame_set_VBR(lame, vbr_off);
-    if (lame_init_params(lame) < 0) {
-        std::cerr << "Failed to initialize LAME\n";
-        return 1;
+    // Start DSP threads, then the input thread feeding them
+    auto start_time = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < channels.size(); i++) {
+        channels[i]->dsp_thread = std::thread(dsp_thread_function, channels[i].get());
     }
+    std::thread rtl_thread(input_thread_function, g_input);
     
-    // Initialize Icecast
-    shout_init();
-    shout_t *shout = shout_new();
-    if (!shout) {
-        std::cerr << "Could not allocate shout_t\n";
-        return 1;
+    // Start encoder threads and the Icecast event loop
+    for (size_t i = 0; i < channels.size(); i++) {
+        channels[i]->encoder_thread = std::thread(encoder_thread_function, channels[i].get());
     }
-
-    shout_set_host(shout, g_config.icecast_host.c_str());
-    shout_set_port(shout, g_config.icecast_port);
-    shout_set_mount(shout, g_config.icecast_mount.c_str());
-    shout_set_user(shout, g_config.icecast_user.c_str());
-    shout_set_password(shout, g_config.icecast_password.c_str());
-    
-    // Use older API calls for better compatibility
-    shout_set_format(shout, SHOUT_FORMAT_MP3);
-    
-    shout_set_protocol(shout, SHOUT_PROTOCOL_HTTP);
-    
-    // Set station name using older API call
-    shout_set_name(shout, g_config.icecast_station_title.c_str());
-    
-    // Use blocking mode for initial connection
-    shout_set_nonblocking(shout, 0);
-    
-    printf("Connecting to Icecast server %s:%d%s...\n", 
-           g_config.icecast_host.c_str(), g_config.icecast_port, g_config.icecast_mount.c_str());
-    
-    int err = shout_open(shout);
-    if (err == SHOUTERR_SUCCESS) {
-        printf("Connected to Icecast server\n");
-        icecast_connected = true;
-        
-        // Set initial metadata
-        last_metadata_update = std::chrono::steady_clock::now();
-    } else {
-        std::cerr << "Error connecting to Icecast: " << shout_get_error(shout) << std::endl;
-        std::cerr << "Will attempt to reconnect in the streaming thread\n";
-        icecast_connected = false;
-        // Continue anyway - the streaming thread will handle reconnection
-    }
-    
-    // Start RTL-SDR thread
-    std::thread rtl_thread(rtl_thread_function, g_dev);
-    
-    // Start Icecast streaming thread
-    std::thread icecast_thread(icecast_thread_function, shout);
-
-    // Buffers for processing
-    std::vector<short> pcm_buffer(CHUNK_SIZE);
-    std::vector<unsigned char> mp3_buffer(MP3_BUFFER_SIZE);
-    
-    auto last_status_time = std::chrono::steady_clock::now();
-    
-    // pre-buffer
-    printf("Pre-buffering...\n");
-    while (true) {
-        std::lock_guard<std::mutex> lock(buffer_mutex);
-        if (audio_buffer.size() >= CHUNK_SIZE*2) {
-            break; // We have enough samples, exit the loop
+    std::thread icecast_thread(icecast_thread_function);
+    
+    // Prometheus endpoint, once everything it reads exists
+    std::unique_ptr<MetricsServer> metrics;
+    if (g_config.metrics_enabled) {
+        metrics.reset(new MetricsServer(collect_metrics));
+        if (!metrics->start(g_config.metrics_bind, g_config.metrics_port)) {
+            metrics.reset();
         }
-        // Optionally, you can add a small sleep to avoid busy waiting        
     }
     
-    printf("All ready - Let's go!\n");
+    auto last_status_time = std::chrono::steady_clock::now();
     
     while (running) 
     {
         auto now = std::chrono::steady_clock::now();
         if (std::chrono::duration_cast<std::chrono::seconds>(now - last_status_time).count() >= 1) {
             if (!quiet) {
-                print_status();
+                for (size_t i = 0; i < channels.size(); i++) {
+                    print_status(*channels[i]);
+                }
             }
             last_status_time = now;
         }
 
-        // Check if we have enough samples
-        bool have_chunk = false;
-        {
-            std::lock_guard<std::mutex> lock(buffer_mutex);
-            have_chunk = audio_buffer.size() >= CHUNK_SIZE;
+        // End of the recording once every channel has encoded its last chunk
+        bool all_finished = true;
+        for (size_t i = 0; i < channels.size(); i++) {
+            all_finished = all_finished && channels[i]->encoder_finished;
         }
-        
-        if (have_chunk) {
-            // Extract chunk and convert to PCM            
-            {
-                std::lock_guard<std::mutex> lock(buffer_mutex);
-                for (int i = 0; i < CHUNK_SIZE; i++) {
-                    float sample = std::max(-1.0f, std::min(1.0f, audio_buffer.front()));
-                    sample *= 0.7f; // Prevent clipping
-                    pcm_buffer[i] = static_cast<short>(sample * 32767.0f);
-                    audio_buffer.pop_front();
-                }
-            }
-            
-            // Encode to MP3
-            int mp3_size = lame_encode_buffer(lame,
-                                            pcm_buffer.data(),
-                                            nullptr,
-                                            CHUNK_SIZE,
-                                            mp3_buffer.data(),
-                                            mp3_buffer.size());
-            
-            if (mp3_size > 0) {
-                // Add MP3 data to queue
-                std::lock_guard<std::mutex> lock(mp3_buffer_mutex);
-                if (mp3_queue.size() < MAX_MP3_QUEUE_SIZE) {
-                    MP3Chunk chunk;
-                    chunk.data.assign(mp3_buffer.begin(), mp3_buffer.begin() + mp3_size);
-                    chunk.size = mp3_size;
-                    mp3_queue.push_back(std::move(chunk));
-                } else {
-                    std::cerr << "MP3 queue full, dropping chunk\n";
-                }
-            }
-        } else {
-            // Add a small sleep to prevent busy waiting
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        if (all_finished) {
+            running = false;
+            break;
         }
 
-        if (g_config.scanEnabled) {
-            double frq = scanner->NextCh(squelch_active);
-            if (frq != 0) {
-                change_frequency(frq);
+        if (g_config.scanEnabled && !pscanner) {
+            const ScanList *next = scanner->NextCh(channels[0]->squelch_active);
+            if (next) {
+                request_retune(*channels[0], *next);
             }
         }
+        
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
     
     // Cleanup
-    rtlsdr_cancel_async(g_dev);  // Stop async reading
+    metrics.reset();
+    g_input->stop();  // Stop async reading
+    
+    // Wake every waiting thread so it sees running == false now
+    // rather than at its next timeout
+    iq_ready.notify();
+    iq_space.notify();
+    frames_ready.notify();
+    for (size_t i = 0; i < channels.size(); i++) {
+        channels[i]->audio_ready.notify();
+        channels[i]->audio_space.notify();
+        for (size_t o = 0; o < channels[i]->outputs.size(); o++) {
+            channels[i]->outputs[o].queue->wake();
+        }
+    }
     if (rtl_thread.joinable()) {
         rtl_thread.join();
     }
+    double encoded_seconds = 0.0;
+    for (size_t i = 0; i < channels.size(); i++) {
+        Channel &ch = *channels[i];
+        if (ch.dsp_thread.joinable()) {
+            ch.dsp_thread.join();
+        }
+        if (ch.encoder_thread.joinable()) {
+            ch.encoder_thread.join();
+        }
+        encoded_seconds += (double)ch.encoded_samples.load() / ch.cfg.audio.samples_per_second();
+    }
     if (icecast_thread.joinable()) {
         icecast_thread.join();
     }
-    msresamp_rrrf_destroy(resampler);
-    iirfilt_crcf_destroy(filter);  // Clean up filter
-    
-    // Clean up low-cut filter
-    if (lowcut_filter) {
-        iirfilt_rrrf_destroy(lowcut_filter);
-    }
-    
+    delete iq_blocks;
     delete scanner;
-    rtlsdr_close(g_dev);
-    lame_close(lame);
-    shout_close(shout);
-    shout_free(shout);
+    delete pscanner;
+    
+    // Throughput summary for replayed recordings
+    IqFileSource *file_input = dynamic_cast<IqFileSource *>(g_input);
+    if (file_input) {
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        double iq_seconds = (double)file_input->samples_delivered() / g_config.sample_rate;
+        printf("Replayed %.1f s of IQ in %.2f s (%.1fx real time), encoded %.1f s of audio on %zu channel(s)\n",
+               iq_seconds, wall, iq_seconds / std::max(wall, 1e-6),
+               encoded_seconds, channels.size());
+        
+        // Each DSP thread runs on one core, so its own time shows whether
+        // the receive chain (stereo and RDS decoding included) keeps up
+        for (size_t i = 0; i < channels.size(); i++) {
+            Channel &ch = *channels[i];
+            double chain_iq = (double)ch.dsp_iq_samples.load() / g_config.sample_rate;
+            double dsp = ch.dsp_seconds.load();
+            std::string wfm;
+            if (ch.cfg.audio.channels == 2) {
+                wfm += ch.pipeline->pilot_locked() ? ", stereo pilot locked" : ", no stereo pilot";
+            }
+            if (ch.pipeline->rds()) {
+                const RdsDecoder *rds = ch.pipeline->rds();
+                wfm += ", RDS " + std::to_string(rds->groups()) + " groups";
+                if (!rds->station_name().empty()) {
+                    wfm += " '" + rds->station_name() + "'";
+                }
+            }
+            printf("  %s: receive chain %.2f s for %.1f s of IQ (%.1fx real time)%s\n",
+                   ch.cfg.name.c_str(), dsp, chain_iq, chain_iq / std::max(dsp, 1e-6), wfm.c_str());
+        }
+    }
+    delete g_input;
+    for (size_t i = 0; i < channels.size(); i++) {
+        Channel &ch = *channels[i];
+        delete ch.pipeline;
+        delete ch.audio_buffer;
+        delete ch.audio_stamps;
+        for (size_t o = 0; o < ch.outputs.size(); o++) {
+            delete ch.outputs[o].sender;
+            delete ch.outputs[o].queue;
+        }
+        delete ch.encoder;
+    }
+    channels.clear();
     shout_shutdown();
     
     return 0;
@@ -1,6 +1,11 @@
 #include <vector>
 #include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include "scanner.h"
+#include "config.h"
+#include "iq_convert.h"
 
 Scanner::Scanner(std::vector<ScanList> scanlist) {
     ch_index = channels.size();
@@ -14,10 +19,10 @@ Scanner::Scanner(std::vector<ScanList> scanlist) {
     }
 }
 
-double Scanner::NextCh(bool sql)
+const ScanList *Scanner::NextCh(bool sql)
 {
     static auto last_time = std::chrono::steady_clock::now();
-    double retval = 0.0f;
+    const ScanList *retval = nullptr;
 
     if (sql == true) {
         auto now = std::chrono::steady_clock::now();
@@ -30,7 +35,7 @@ double Scanner::NextCh(bool sql)
             }
         
             if (!channels.empty()) {
-                retval = channels[ch_index].frequency;
+                retval = &channels[ch_index];
             }
         } 
     }
@@ -41,4 +46,174 @@ double Scanner::NextCh(bool sql)
 void Scanner::SetStepDelay(uint16_t delay)
 {
     stepDelayMs = delay;
-}
\ No newline at end of file
+}
+
+#define SCAN_FFT_SIZE 1024
+#define SCAN_FFT_AVERAGES 16     // FFTs averaged per measurement
+#define SCAN_USABLE_BW 0.8       // Fraction of the sample rate clear of the anti-alias roll-off
+
+// Bandwidth over which an entry's power is measured, by modulation
+static float scan_bandwidth(const std::string &modulation) {
+    ModulationMode mode = ConfigParser::parse_mode(modulation);
+    if (mode == ModulationMode::AM_MODE) return 10000.0f;
+    if (mode == ModulationMode::NFM_MODE) return 12500.0f;
+    return 150000.0f;
+}
+
+PassbandScanner::PassbandScanner(const std::vector<ScanList> &scanlist, int sample_rate, IqSampleFormat format,
+                                 float threshold_db, uint16_t hold_ms) :
+    channels(scanlist),
+    sample_rate(sample_rate),
+    format(format),
+    threshold_db(threshold_db),
+    holdMs(hold_ms),
+    state(MEASURE),
+    window(0),
+    active(0),
+    measured(0),
+    fft_in(SCAN_FFT_SIZE),
+    fft_out(SCAN_FFT_SIZE),
+    fft_window(SCAN_FFT_SIZE),
+    bin_power(SCAN_FFT_SIZE)
+{
+    for (size_t i = 0; i < channels.size(); i++) {
+        bandwidth_hz.push_back(scan_bandwidth(channels[i].modulation_mode));
+    }
+
+    // Sort by frequency, then greedily pack entries into windows
+    std::vector<size_t> order(channels.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return channels[a].frequency < channels[b].frequency;
+    });
+
+    double usable_hz = SCAN_USABLE_BW * sample_rate;
+    for (size_t i = 0; i < order.size(); ) {
+        ScanWindow w;
+        double low = channels[order[i]].frequency * 1e6 - bandwidth_hz[order[i]] / 2;
+        double high = low;
+        while (i < order.size()) {
+            double edge = channels[order[i]].frequency * 1e6 + bandwidth_hz[order[i]] / 2;
+            if (!w.entries.empty() && edge - low > usable_hz) {
+                break;
+            }
+            high = std::max(high, edge);
+            w.entries.push_back(order[i]);
+            i++;
+        }
+        w.center_hz = (low + high) / 2;
+        windows.push_back(w);
+    }
+    if (windows.empty()) {
+        windows.push_back(ScanWindow());
+        windows[0].center_hz = 0.0;
+    }
+
+    // Hann window, the averaged bin powers are normalized by its energy
+    for (size_t i = 0; i < SCAN_FFT_SIZE; i++) {
+        fft_window[i] = 0.5f - 0.5f * cosf(2.0f * M_PI * i / SCAN_FFT_SIZE);
+    }
+    plan = fft_create_plan(SCAN_FFT_SIZE, fft_in.data(), fft_out.data(), LIQUID_FFT_FORWARD, 0);
+
+    printf("[Scanner] %zu channels in %zu passband windows of %.0f kHz\n",
+           channels.size(), windows.size(), usable_hz / 1000.0);
+}
+
+PassbandScanner::~PassbandScanner() {
+    fft_destroy_plan(plan);
+}
+
+double PassbandScanner::ActiveOffset() const {
+    return channels[active].frequency * 1e6 - WindowCenter();
+}
+
+void PassbandScanner::MeasureWindow(const uint8_t *iq, size_t len) {
+    size_t sample_bytes = iq_sample_bytes(format);
+    size_t samples = len / sample_bytes;
+    size_t averages = std::min<size_t>(SCAN_FFT_AVERAGES, samples / SCAN_FFT_SIZE);
+    std::fill(bin_power.begin(), bin_power.end(), 0.0f);
+    for (size_t a = 0; a < averages; a++) {
+        iq_convert(format, iq + sample_bytes * a * SCAN_FFT_SIZE, fft_in.data(), SCAN_FFT_SIZE);
+        for (size_t i = 0; i < SCAN_FFT_SIZE; i++) {
+            fft_in[i] *= fft_window[i];
+        }
+        fft_execute(plan);
+        for (size_t i = 0; i < SCAN_FFT_SIZE; i++) {
+            bin_power[i] += std::norm(fft_out[i]);
+        }
+    }
+
+    // Parseval: mean sample power = sum |X|^2 / (N * sum w^2)
+    float window_energy = 0.0f;
+    for (size_t i = 0; i < SCAN_FFT_SIZE; i++) {
+        window_energy += fft_window[i] * fft_window[i];
+    }
+    float norm = 1.0f / (SCAN_FFT_SIZE * window_energy * std::max<size_t>(averages, 1));
+
+    const ScanWindow &w = windows[window];
+    double bin_hz = static_cast<double>(sample_rate) / SCAN_FFT_SIZE;
+    power_db.assign(w.entries.size(), -120.0f);
+    for (size_t e = 0; e < w.entries.size(); e++) {
+        size_t ch = w.entries[e];
+        double offset = channels[ch].frequency * 1e6 - w.center_hz;
+        int first = static_cast<int>(std::ceil((offset - bandwidth_hz[ch] / 2) / bin_hz));
+        int last = static_cast<int>(std::floor((offset + bandwidth_hz[ch] / 2) / bin_hz));
+        float sum = 0.0f;
+        for (int k = first; k <= last; k++) {
+            if (k == 0) {
+                continue;  // Skip the DC spike of the tuner
+            }
+            sum += bin_power[(k + SCAN_FFT_SIZE) % SCAN_FFT_SIZE];
+        }
+        power_db[e] = 10.0f * std::log10(sum * norm + 1e-12f);
+    }
+    measured += w.entries.size();
+}
+
+ScanAction PassbandScanner::NextWindow() {
+    if (windows.size() == 1) {
+        state = MEASURE;
+        return ScanAction::NONE;
+    }
+    window = (window + 1) % windows.size();
+    state = MEASURE;
+    return ScanAction::RETUNE;
+}
+
+ScanAction PassbandScanner::Feed(const uint8_t *iq, size_t len, bool squelch_open) {
+    switch (state) {
+        case MEASURE: {
+            MeasureWindow(iq, len);
+            const ScanWindow &w = windows[window];
+            int loudest = -1;
+            for (size_t e = 0; e < w.entries.size(); e++) {
+                if (power_db[e] >= threshold_db && (loudest < 0 || power_db[e] > power_db[loudest])) {
+                    loudest = static_cast<int>(e);
+                }
+            }
+            if (loudest >= 0) {
+                active = w.entries[loudest];
+                state = LISTEN;
+                last_open = std::chrono::steady_clock::now();
+                return ScanAction::LISTEN;
+            }
+            return NextWindow();
+        }
+
+        case LISTEN: {
+            // Stay on the channel until it has been quiet for the hold time
+            auto now = std::chrono::steady_clock::now();
+            if (squelch_open) {
+                last_open = now;
+                return ScanAction::NONE;
+            }
+            if (std::chrono::duration_cast<std::chrono::milliseconds>(now - last_open).count() < holdMs) {
+                return ScanAction::NONE;
+            }
+            return NextWindow();
+        }
+    }
+    return ScanAction::NONE;
+}
@@ -1,8 +1,14 @@
 #ifndef _SCANNER_H
 #define _SCANNER_H
 
+#include <atomic>
+#include <chrono>
+#include <complex>
+#include <cstdint>
 #include <string>
 #include <vector>
+#include <liquid/liquid.h>
+#include "iq_convert.h"
 
 typedef struct {
     double frequency;
@@ -18,8 +24,78 @@ class Scanner {
 
     public:
         Scanner(std::vector<ScanList> scanlist);
-        double NextCh(bool frq);
+        // Next entry to tune to once the current one has been quiet for
+        // the step delay, or nullptr to stay
+        const ScanList *NextCh(bool sql);
         void SetStepDelay(uint16_t delay);
 };
 
+// Group of scanlist entries that fit in the passband around one tuning
+struct ScanWindow {
+    double center_hz;
+    std::vector<size_t> entries;  // Indices into the scanlist
+};
+
+enum class ScanAction {
+    NONE,      // Keep going
+    RETUNE,    // Tune the dongle to WindowCenter()
+    LISTEN,    // Demodulate the entry at ActiveOffset() from the center
+};
+
+// Scans the whole passband at once: scanlist entries are grouped into
+// windows that fit the sample rate, and every entry of a window is
+// measured from one averaged FFT of an IQ block. The dongle is retuned
+// only between windows; the caller must not feed blocks captured before
+// a retune completed.
+class PassbandScanner {
+    public:
+        PassbandScanner(const std::vector<ScanList> &scanlist, int sample_rate, IqSampleFormat format,
+                        float threshold_db, uint16_t hold_ms);
+        ~PassbandScanner();
+
+        // Feed one raw IQ block taken at the current window, 'len' bytes
+        // in the input's sample format. squelch_open tells whether the
+        // channel being listened to still has a signal.
+        ScanAction Feed(const uint8_t *iq, size_t len, bool squelch_open);
+
+        bool Listening() const { return state == LISTEN; }
+        double WindowCenter() const { return windows[window].center_hz; }
+        double ActiveOffset() const;
+        const ScanList &Active() const { return channels[active]; }
+        size_t WindowCount() const { return windows.size(); }
+        // Entries measured so far, for scan rate reporting
+        uint64_t Measured() const { return measured.load(std::memory_order_relaxed); }
+
+    private:
+        PassbandScanner(const PassbandScanner &);
+        PassbandScanner &operator=(const PassbandScanner &);
+
+        enum State { MEASURE, LISTEN };
+
+        // Power of each entry of the current window in dB, from the FFT
+        void MeasureWindow(const uint8_t *iq, size_t len);
+        ScanAction NextWindow();
+
+        std::vector<ScanList> channels;
+        std::vector<float> bandwidth_hz;   // Measurement bandwidth per entry
+        std::vector<ScanWindow> windows;
+        std::vector<float> power_db;       // Per entry of the current window
+        int sample_rate;
+        IqSampleFormat format;
+        float threshold_db;
+        uint16_t holdMs;
+
+        State state;
+        size_t window;
+        size_t active;
+        std::atomic<uint64_t> measured;
+        std::chrono::steady_clock::time_point last_open;
+
+        std::vector<std::complex<float>> fft_in;
+        std::vector<std::complex<float>> fft_out;
+        std::vector<float> fft_window;
+        std::vector<float> bin_power;
+        fftplan plan;
+};
+
 #endif // _SCANNER_H
@@ -0,0 +1,121 @@
+// Checks the fast FM discriminator against the exact one: the polynomial
+// atan2 error over a full turn, and the SNR of a noisy FM tone decoded
+// both ways. Exits non-zero on failure; run with "make test".
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "fm_demod.h"
+
+#define TEST_SAMPLE_RATE 240000.0f
+#define TEST_TONE_HZ 1000.0
+#define TEST_DEVIATION_HZ 50000.0
+#define TEST_CNR_DB 20.0           // Carrier to noise in the channel
+#define TEST_SECONDS 1.0
+#define TEST_SETTLE_SECONDS 0.2    // Skipped while the DC blocker settles
+#define TEST_BLOCK 4096
+
+#define MAX_ATAN2_ERROR 2e-6       // rad, as documented
+#define MAX_SNR_DIFFERENCE_DB 0.1
+
+static bool check_atan2() {
+    // Sweep a full turn at a few magnitudes, the polynomial only sees the
+    // ratio of the two but the 1e-30 guard should not show
+    const int steps = 1000000;
+    const float magnitudes[] = { 1e-6f, 1.0f, 1e6f };
+    double max_error = 0.0;
+    for (float m : magnitudes) {
+        for (int i = 0; i < steps; i++) {
+            double t = -M_PI + 2.0 * M_PI * i / steps;
+            float y = m * static_cast<float>(std::sin(t));
+            float x = m * static_cast<float>(std::cos(t));
+            double error = std::fabs(fast_atan2(y, x) - std::atan2(static_cast<double>(y), static_cast<double>(x)));
+            // -pi and pi are the same angle
+            error = std::min(error, 2.0 * M_PI - error);
+            max_error = std::max(max_error, error);
+        }
+    }
+    bool ok = max_error <= MAX_ATAN2_ERROR;
+    printf("%s fast_atan2 max error %.3g rad (limit %.3g)\n", ok ? "PASS" : "FAIL", max_error, MAX_ATAN2_ERROR);
+    return ok;
+}
+
+// Tone power over everything else, by a least squares fit of the tone
+// to the settled part of the output
+static double tone_snr_db(const std::vector<float> &audio) {
+    size_t start = static_cast<size_t>(TEST_SETTLE_SECONDS * TEST_SAMPLE_RATE);
+    double ss = 0.0, cc = 0.0, sc = 0.0, sy = 0.0, cy = 0.0;
+    for (size_t i = start; i < audio.size(); i++) {
+        double w = 2.0 * M_PI * TEST_TONE_HZ * i / TEST_SAMPLE_RATE;
+        double s = std::sin(w), c = std::cos(w);
+        ss += s * s; cc += c * c; sc += s * c;
+        sy += s * audio[i]; cy += c * audio[i];
+    }
+    double det = ss * cc - sc * sc;
+    double a = (sy * cc - cy * sc) / det;
+    double b = (cy * ss - sy * sc) / det;
+    double tone = 0.0, residual = 0.0;
+    for (size_t i = start; i < audio.size(); i++) {
+        double w = 2.0 * M_PI * TEST_TONE_HZ * i / TEST_SAMPLE_RATE;
+        double fit = a * std::sin(w) + b * std::cos(w);
+        tone += fit * fit;
+        residual += (audio[i] - fit) * (audio[i] - fit);
+    }
+    return 10.0 * std::log10(tone / residual);
+}
+
+static std::vector<float> decode(const std::vector<std::complex<float> > &iq, FmDiscriminator disc) {
+    FMDemodulator demod;
+    demod.setMode(ModulationMode::WFM_MODE, TEST_SAMPLE_RATE);
+    demod.setDiscriminator(disc);
+    std::vector<float> audio(iq.size());
+    for (size_t base = 0; base < iq.size(); base += TEST_BLOCK) {
+        size_t n = std::min<size_t>(TEST_BLOCK, iq.size() - base);
+        demod.demodulate(&iq[base], &audio[base], n);
+    }
+    return audio;
+}
+
+static bool check_tone() {
+    // Unit carrier frequency modulated by the tone, plus complex Gaussian
+    // noise; a fixed seed keeps the run repeatable
+    size_t count = static_cast<size_t>(TEST_SECONDS * TEST_SAMPLE_RATE);
+    std::mt19937 rng(1);
+    std::normal_distribution<float> noise(0.0f, static_cast<float>(std::sqrt(0.5 * std::pow(10.0, -TEST_CNR_DB / 10.0))));
+    std::vector<std::complex<float> > iq(count);
+    double phase = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        double f = TEST_DEVIATION_HZ * std::sin(2.0 * M_PI * TEST_TONE_HZ * i / TEST_SAMPLE_RATE);
+        phase = std::fmod(phase + 2.0 * M_PI * f / TEST_SAMPLE_RATE, 2.0 * M_PI);
+        iq[i] = std::polar(1.0f, static_cast<float>(phase)) + std::complex<float>(noise(rng), noise(rng));
+    }
+
+    std::vector<float> exact = decode(iq, FmDiscriminator::EXACT);
+    std::vector<float> fast = decode(iq, FmDiscriminator::FAST);
+
+    // Per sample, back in radians; the scale is rate / (2 pi deviation)
+    const double scale = TEST_SAMPLE_RATE / (2.0 * M_PI * WFM_DEVIATION);
+    double max_error = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        max_error = std::max(max_error, std::fabs(fast[i] - exact[i]) / scale);
+    }
+    double snr_exact = tone_snr_db(exact);
+    double snr_fast = tone_snr_db(fast);
+    double difference = std::fabs(snr_fast - snr_exact);
+
+    // Float rounding in the conjugate product adds a little on top of
+    // the polynomial error
+    bool phase_ok = max_error <= 2.0 * MAX_ATAN2_ERROR;
+    bool snr_ok = difference <= MAX_SNR_DIFFERENCE_DB;
+    printf("%s tone max phase difference %.3g rad (limit %.3g)\n", phase_ok ? "PASS" : "FAIL", max_error, 2.0 * MAX_ATAN2_ERROR);
+    printf("%s tone SNR exact %.2f dB, fast %.2f dB, difference %.4f dB (limit %.2f)\n",
+           snr_ok ? "PASS" : "FAIL", snr_exact, snr_fast, difference, MAX_SNR_DIFFERENCE_DB);
+    return phase_ok && snr_ok;
+}
+
+int main() {
+    bool ok = check_atan2();
+    ok = check_tone() && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,239 @@
+// Drives IcecastSender against MockIcecast: connecting, pacing on audio
+// duration, reconnecting after a stall, backing off after failed logins
+// and trimming the backlog meanwhile. Exits non-zero on failure; run
+// with "make test", which builds the sender with a short stall timeout.
+
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <shout/shout.h>
+#include "icecast_sender.h"
+#include "mock_icecast.h"
+
+// As in icecast_sender.cpp
+#ifndef ICECAST_STALL_TIMEOUT_S
+#define ICECAST_STALL_TIMEOUT_S 15
+#endif
+#define ICECAST_LONG_RETRY_S 30
+#define ICECAST_PACING_LEAD_MS 1000
+
+#define TEST_BITRATE_KBPS 8        // 1000 bytes/s, far below what pacing on duration sends
+#define TEST_FRAME_BYTES 1000
+#define TEST_FRAME_SECONDS 0.1
+#define TEST_PACING_SECONDS 3.0
+#define TEST_STALL_FRAME_BYTES 65536
+#define TEST_RETRY_ATTEMPTS 3
+#define TEST_RETRY_DELAY_MS 200
+
+typedef std::chrono::steady_clock Clock;
+
+static std::atomic<bool> running(true);
+
+static double seconds_since(Clock::time_point t) {
+    return std::chrono::duration<double>(Clock::now() - t).count();
+}
+
+static bool check(bool ok, const char *what) {
+    printf("%s %s\n", ok ? "PASS" : "FAIL", what);
+    return ok;
+}
+
+static IcecastTarget make_target(int port) {
+    IcecastTarget target;
+    target.host = "127.0.0.1";
+    target.port = port;
+    target.mount = "/test";
+    target.user = "source";
+    target.password = "hackme";
+    target.name = "test";
+    target.format = SHOUT_FORMAT_MP3;
+    target.bitrate_kbps = TEST_BITRATE_KBPS;
+    target.reconnect_attempts = TEST_RETRY_ATTEMPTS;
+    target.reconnect_delay_ms = TEST_RETRY_DELAY_MS;
+    return target;
+}
+
+// Queue silent frames until one short of full, as an encoder would
+static size_t top_up(Mp3FrameQueue &queue, size_t size, double duration) {
+    size_t added = 0;
+    while (queue.size() + 1 < queue.depth()) {
+        Mp3FrameQueue::Frame *frame = queue.acquire(running);
+        if (!frame) {
+            break;
+        }
+        memset(frame->data, 0, size);
+        frame->size = size;
+        frame->duration = duration;
+        frame->arrival = Clock::now();
+        frame->queued = frame->arrival;
+        queue.commit(frame);
+        added++;
+    }
+    return added;
+}
+
+// Call run_once() as the sender thread does until 'done' or the timeout;
+// 'each' runs before every call
+static bool drive(IcecastSender &sender, double timeout_s,
+                  const std::function<bool()> &done,
+                  const std::function<void()> &each = std::function<void()>()) {
+    Clock::time_point start = Clock::now();
+    while (seconds_since(start) < timeout_s) {
+        if (each) {
+            each();
+        }
+        std::chrono::milliseconds wait = sender.run_once();
+        if (done()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::min(wait, std::chrono::milliseconds(10)));
+    }
+    return false;
+}
+
+static bool test_connect(MockIcecast &mock) {
+    mock.set_mode(MockIcecast::ACCEPT);
+    Mp3FrameQueue queue(8, TEST_FRAME_BYTES, Mp3Overflow::DROP_NEWEST);
+    IcecastSender sender(make_target(mock.port()), queue);
+    uint64_t logins = mock.logins();
+
+    bool ok = check(drive(sender, 5.0, [&] { return sender.connected(); }), "connect: sender reaches CONNECTED");
+    ok = check(mock.logins() == logins + 1, "connect: one login") && ok;
+    ok = check(mock.last_request().find(" /test ") != std::string::npos, "connect: login names the mount") && ok;
+    return ok;
+}
+
+static bool test_pacing(MockIcecast &mock) {
+    mock.set_mode(MockIcecast::ACCEPT);
+    Mp3FrameQueue queue(64, TEST_FRAME_BYTES, Mp3Overflow::DROP_NEWEST);
+    IcecastSender sender(make_target(mock.port()), queue);
+    if (!check(drive(sender, 5.0, [&] { return sender.connected(); }), "pacing: connect")) {
+        return false;
+    }
+    uint64_t received = mock.bytes();
+    Clock::time_point start = Clock::now();
+    drive(sender, TEST_PACING_SECONDS, [] { return false; },
+          [&] { top_up(queue, TEST_FRAME_BYTES, TEST_FRAME_SECONDS); });
+    double elapsed = seconds_since(start);
+
+    // Let the mock read what is still in flight
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    received = mock.bytes() - received;
+
+    // The stream runs up to the lead ahead of real time, by audio time;
+    // pacing by the nominal bitrate would send only elapsed * 1000 bytes
+    double audio = sender.bytes_sent() / TEST_FRAME_BYTES * TEST_FRAME_SECONDS;
+    double expected = elapsed + ICECAST_PACING_LEAD_MS / 1000.0;
+    printf("     %.2f s of audio sent in %.2f s, %llu bytes received\n",
+           audio, elapsed, static_cast<unsigned long long>(received));
+    bool ok = check(audio > expected - 0.3 && audio < expected + 0.3, "pacing: audio time sent follows the clock plus the lead");
+    ok = check(received == sender.bytes_sent(), "pacing: the mock received every byte") && ok;
+    return ok;
+}
+
+static bool test_stall(MockIcecast &mock) {
+    mock.set_mode(MockIcecast::STALL);
+    Mp3FrameQueue queue(16, TEST_STALL_FRAME_BYTES, Mp3Overflow::DROP_NEWEST);
+    IcecastSender sender(make_target(mock.port()), queue);
+    if (!check(drive(sender, 5.0, [&] { return sender.connected(); }), "stall: connect")) {
+        return false;
+    }
+
+    // Frames without a duration are not paced, so the socket fills up
+    uint64_t sent = 0;
+    Clock::time_point last_change = Clock::now();
+    bool lost = drive(sender, ICECAST_STALL_TIMEOUT_S + 10.0,
+                      [&] {
+                          if (sender.bytes_sent() != sent) {
+                              sent = sender.bytes_sent();
+                              last_change = Clock::now();
+                          }
+                          return !sender.connected();
+                      },
+                      [&] { top_up(queue, TEST_STALL_FRAME_BYTES, 0.0); });
+    double stalled = seconds_since(last_change);
+    printf("     stalled for %.2f s after %llu bytes\n", stalled, static_cast<unsigned long long>(sent));
+    bool ok = check(lost, "stall: sender drops the connection");
+    ok = check(stalled > ICECAST_STALL_TIMEOUT_S - 0.5 && stalled < ICECAST_STALL_TIMEOUT_S + 1.0,
+               "stall: after the stall timeout") && ok;
+
+    // The lost connection is retried at once
+    mock.set_mode(MockIcecast::ACCEPT);
+    ok = check(drive(sender, 5.0, [&] { return sender.connected(); }), "stall: reconnects") && ok;
+    ok = check(sender.reconnects() == 1, "stall: counted as one reconnect") && ok;
+    return ok;
+}
+
+static bool test_backoff(MockIcecast &mock) {
+    mock.set_mode(MockIcecast::REJECT);
+    Mp3FrameQueue queue(64, TEST_FRAME_BYTES, Mp3Overflow::DROP_NEWEST);
+    IcecastSender sender(make_target(mock.port()), queue);
+    uint64_t logins = mock.logins();
+    size_t queued = top_up(queue, TEST_FRAME_BYTES, TEST_FRAME_SECONDS);
+
+    // Note how long the sender waits after each failed login
+    std::vector<int64_t> waits;
+    Clock::time_point start = Clock::now();
+    while (waits.size() < TEST_RETRY_ATTEMPTS && seconds_since(start) < 10.0) {
+        IcecastSender::State before = sender.state();
+        std::chrono::milliseconds wait = sender.run_once();
+        if (before != IcecastSender::BACKOFF && sender.state() == IcecastSender::BACKOFF) {
+            waits.push_back(wait.count());
+        }
+        std::this_thread::sleep_for(std::min(wait, std::chrono::milliseconds(10)));
+    }
+    bool ok = check(waits.size() == TEST_RETRY_ATTEMPTS && mock.logins() == logins + TEST_RETRY_ATTEMPTS,
+                    "backoff: each attempt logs in and fails");
+    for (size_t i = 0; i < waits.size(); i++) {
+        printf("     attempt %zu failed, retry in %lld ms\n", i + 1, static_cast<long long>(waits[i]));
+    }
+    if (waits.size() == TEST_RETRY_ATTEMPTS) {
+        bool quick = true;
+        for (size_t i = 0; i + 1 < waits.size(); i++) {
+            quick = quick && waits[i] > TEST_RETRY_DELAY_MS - 50 && waits[i] <= TEST_RETRY_DELAY_MS;
+        }
+        ok = check(quick, "backoff: quick retries after reconnect_delay_ms") && ok;
+        ok = check(waits.back() > (ICECAST_LONG_RETRY_S - 1) * 1000, "backoff: long pause after reconnect_attempts failures") && ok;
+    }
+    std::string retry = "retry in " + std::to_string(ICECAST_LONG_RETRY_S - 1) + "s";
+    ok = check(sender.status_text().find(retry) != std::string::npos, "backoff: status shows the long pause") && ok;
+
+    // Only what the lead would send after reconnecting is kept
+    size_t keep = TEST_BITRATE_KBPS * 1000 / 8 * ICECAST_PACING_LEAD_MS / 1000;
+    printf("     %zu frames queued, %llu discarded, %zu bytes kept\n",
+           queued, static_cast<unsigned long long>(sender.discarded()), queue.bytes());
+    ok = check(queue.bytes() <= keep && sender.discarded() + queue.size() == queued,
+               "trim: backlog cut to the pacing lead while disconnected") && ok;
+
+    // Nothing may be lost with the block policy
+    Mp3FrameQueue blocking(64, TEST_FRAME_BYTES, Mp3Overflow::BLOCK);
+    IcecastSender held(make_target(mock.port()), blocking);
+    queued = top_up(blocking, TEST_FRAME_BYTES, TEST_FRAME_SECONDS);
+    drive(held, 5.0, [&] { return held.state() == IcecastSender::BACKOFF; });
+    ok = check(held.discarded() == 0 && blocking.size() == queued, "trim: block policy keeps the backlog") && ok;
+    return ok;
+}
+
+int main() {
+    // A rejected login closes the socket under libshout
+    signal(SIGPIPE, SIG_IGN);
+    shout_init();
+
+    MockIcecast mock;
+    if (!mock.start()) {
+        printf("FAIL mock server did not start\n");
+        return 1;
+    }
+    printf("Mock Icecast on 127.0.0.1:%d, stall timeout %d s\n", mock.port(), ICECAST_STALL_TIMEOUT_S);
+
+    bool ok = test_connect(mock);
+    ok = test_pacing(mock) && ok;
+    ok = test_stall(mock) && ok;
+    ok = test_backoff(mock) && ok;
+
+    shout_shutdown();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "mock_icecast.h"
+
+#define MOCK_POLL_MS 20          // Recheck 'running' this often
+#define MOCK_RCVBUF 4096         // Small, so a stalled stream backs up quickly
+
+MockIcecast::MockIcecast() :
+    listen_fd(-1),
+    listen_port(0),
+    client_fd(-1),
+    streaming(false),
+    stalled(false),
+    current_mode(ACCEPT),
+    running(false),
+    login_count(0),
+    stream_bytes(0)
+{
+}
+
+MockIcecast::~MockIcecast() {
+    running.store(false);
+    if (worker.joinable()) {
+        worker.join();
+    }
+    drop_client();
+    if (listen_fd >= 0) {
+        close(listen_fd);
+    }
+}
+
+bool MockIcecast::start() {
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        return false;
+    }
+    // Accepted sockets inherit the buffer size
+    int rcvbuf = MOCK_RCVBUF;
+    setsockopt(listen_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t len = sizeof(addr);
+    if (bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        listen(listen_fd, 4) != 0 ||
+        getsockname(listen_fd, reinterpret_cast<sockaddr *>(&addr), &len) != 0) {
+        return false;
+    }
+    listen_port = ntohs(addr.sin_port);
+
+    running.store(true);
+    worker = std::thread(&MockIcecast::serve, this);
+    return true;
+}
+
+std::string MockIcecast::last_request() const {
+    std::lock_guard<std::mutex> lock(request_mutex);
+    return request_line;
+}
+
+void MockIcecast::drop_client() {
+    if (client_fd >= 0) {
+        close(client_fd);
+        client_fd = -1;
+    }
+    streaming = false;
+    stalled = false;
+    request.clear();
+}
+
+void MockIcecast::serve() {
+    while (running.load()) {
+        pollfd fds[2];
+        fds[0].fd = listen_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = client_fd;
+        // A stalled client is left alone until the next connection
+        fds[1].events = stalled ? 0 : POLLIN;
+        int n = poll(fds, (client_fd >= 0) ? 2 : 1, MOCK_POLL_MS);
+        if (n <= 0) {
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd >= 0) {
+                drop_client();
+                client_fd = fd;
+                continue;
+            }
+        }
+        if (client_fd >= 0 && (fds[1].revents & (POLLIN | POLLHUP | POLLERR))) {
+            if (!read_client()) {
+                drop_client();
+            }
+        }
+    }
+}
+
+bool MockIcecast::read_client() {
+    char buf[4096];
+    ssize_t n = recv(client_fd, buf, sizeof(buf), 0);
+    if (n <= 0) {
+        return false;
+    }
+    if (streaming) {
+        stream_bytes.fetch_add(n);
+        return true;
+    }
+
+    request.append(buf, n);
+    size_t end;
+    while (!streaming && (end = request.find("\r\n\r\n")) != std::string::npos) {
+        std::string head = request.substr(0, end);
+        request.erase(0, end + 4);
+        if (!handle_request(head)) {
+            return false;
+        }
+    }
+    // Stream data that came in with the login
+    if (streaming && !request.empty()) {
+        stream_bytes.fetch_add(request.size());
+        request.clear();
+    }
+    return true;
+}
+
+// Answer one request head the way Icecast does. Returns false to hang up.
+bool MockIcecast::handle_request(const std::string &head) {
+    std::string line = head.substr(0, head.find("\r\n"));
+    if (line.compare(0, 8, "OPTIONS ") == 0) {
+        // libshout probes the server before logging in
+        return reply("HTTP/1.1 200 OK\r\nAllow: GET, PUT, SOURCE, OPTIONS\r\nContent-Length: 0\r\n\r\n");
+    }
+    if (line.compare(0, 4, "PUT ") != 0 && line.compare(0, 7, "SOURCE ") != 0) {
+        reply("HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n");
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(request_mutex);
+        request_line = line;
+    }
+    login_count.fetch_add(1);
+    if (current_mode.load() == REJECT) {
+        reply("HTTP/1.1 401 Authentication Required\r\nContent-Length: 0\r\n\r\n");
+        return false;
+    }
+    // Icecast answers "Expect: 100-continue" with the 100 alone
+    bool expect = head.find("100-continue") != std::string::npos;
+    if (!reply(expect ? "HTTP/1.1 100 Continue\r\n\r\n" : "HTTP/1.0 200 OK\r\n\r\n")) {
+        return false;
+    }
+    streaming = true;
+    stalled = current_mode.load() == STALL;
+    return true;
+}
+
+bool MockIcecast::reply(const char *text) {
+    size_t len = strlen(text);
+    return send(client_fd, text, len, MSG_NOSIGNAL) == static_cast<ssize_t>(len);
+}
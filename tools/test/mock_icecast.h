@@ -0,0 +1,66 @@
+#ifndef _MOCK_ICECAST_H
+#define _MOCK_ICECAST_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Minimal Icecast source endpoint on 127.0.0.1 for testing IcecastSender.
+// It answers the libshout HTTP login (OPTIONS probe, PUT or SOURCE) the
+// way Icecast does and then reads the stream, or stalls or refuses as
+// told. One connection is served at a time; a new one replaces it.
+class MockIcecast {
+    public:
+        enum Mode {
+            ACCEPT,  // Log in and read everything
+            STALL,   // Log in, then stop reading
+            REJECT   // Answer the login with 401 and hang up
+        };
+
+        MockIcecast();
+        ~MockIcecast();
+
+        // Listen on an ephemeral port and start serving; false on error
+        bool start();
+        int port() const { return listen_port; }
+
+        // Applies to the next login
+        void set_mode(Mode mode) { current_mode.store(mode); }
+
+        // Source logins answered, whatever the mode
+        uint64_t logins() const { return login_count.load(); }
+        // Stream bytes read after a login
+        uint64_t bytes() const { return stream_bytes.load(); }
+        // Request line of the last login, e.g. "PUT /test HTTP/1.1"
+        std::string last_request() const;
+
+    private:
+        MockIcecast(const MockIcecast &);
+        MockIcecast &operator=(const MockIcecast &);
+
+        void serve();
+        void drop_client();
+        // Handle what has arrived on the client; false once it is gone
+        bool read_client();
+        bool handle_request(const std::string &head);
+        bool reply(const char *text);
+
+        int listen_fd;
+        int listen_port;
+        int client_fd;
+        bool streaming;           // Client logged in, the rest is stream data
+        bool stalled;             // Client logged in in STALL mode
+        std::string request;      // Bytes of a request still being read
+
+        std::atomic<int> current_mode;
+        std::atomic<bool> running;
+        std::atomic<uint64_t> login_count;
+        std::atomic<uint64_t> stream_bytes;
+        mutable std::mutex request_mutex;
+        std::string request_line;
+        std::thread worker;
+};
+
+#endif // _MOCK_ICECAST_H
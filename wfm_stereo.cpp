@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <cmath>
+#include "wfm_stereo.h"
+
+#define PILOT_HZ 19000.0
+#define PILOT_PULL_HZ 10.0          // Pilot is +-2 Hz, plus the dongle's clock error
+#define PILOT_LOOP_HZ 20.0          // PLL natural frequency
+#define PILOT_DETECT_HZ 200.0       // Phase detector low-pass
+#define PILOT_LOCK_LEVEL 0.01f      // Half amplitude, ~2% of deviation
+#define PILOT_UNLOCK_LEVEL 0.007f
+#define STEREO_BLEND_MS 50          // Mono/stereo crossfade
+#define STEREO_AUDIO_HZ 15000.0
+#define STEREO_STOP_HZ 18500.0      // Below the pilot
+#define STEREO_STOPBAND_DB 60.0f
+#define STEREO_MIN_RATE 32000       // Lowest intermediate rate
+#define SINE_BITS 12
+#define SINE_SIZE (1 << SINE_BITS)
+#define SINE_MASK (SINE_SIZE - 1)
+
+static std::vector<float> make_sine_table() {
+    std::vector<float> table(SINE_SIZE);
+    for (int i = 0; i < SINE_SIZE; i++) {
+        table[i] = static_cast<float>(std::sin(2.0 * M_PI * i / SINE_SIZE));
+    }
+    return table;
+}
+
+// One period of sin(), indexed by the top bits of a 32-bit phase
+static const float *sine_table() {
+    static const std::vector<float> table = make_sine_table();
+    return table.data();
+}
+
+WfmStereoDecoder::WfmStereoDecoder(double mpx_rate, int audio_rate, bool stereo, float deemphasis_us, RdsDecoder *rds,
+                                   size_t max_block) :
+    stereo(stereo),
+    rds(rds),
+    max_block(std::max<size_t>(max_block, 1)),
+    sum_filter(nullptr),
+    diff_filter(nullptr),
+    decim(1),
+    filter_len(0),
+    fill(0),
+    locked(false),
+    level(0.0f)
+{
+    // Second order loop with a damping of 0.707, gains in rad/sample
+    double wn = 2.0 * M_PI * PILOT_LOOP_HZ / mpx_rate;
+    kp = static_cast<float>(2.0 * 0.707 * wn);
+    ki = static_cast<float>(wn * wn);
+    freq_nominal = static_cast<float>(2.0 * M_PI * PILOT_HZ / mpx_rate);
+    freq_limit = static_cast<float>(2.0 * M_PI * PILOT_PULL_HZ / mpx_rate);
+    iq_alpha = static_cast<float>(1.0 - std::exp(-2.0 * M_PI * PILOT_DETECT_HZ / mpx_rate));
+
+    // Integer decimation to at least the audio rate, resampled from there
+    decim = std::max(1, static_cast<int>(mpx_rate / std::max(audio_rate, STEREO_MIN_RATE)));
+    mid_rate = mpx_rate / decim;
+
+    float fc = static_cast<float>(0.5 * (STEREO_AUDIO_HZ + STEREO_STOP_HZ) / mpx_rate);
+    float transition = static_cast<float>((STEREO_STOP_HZ - STEREO_AUDIO_HZ) / mpx_rate);
+    filter_len = estimate_req_filter_len(transition, STEREO_STOPBAND_DB);
+    filter_len = std::max(filter_len, 2 * decim + 1) | 1;
+    std::vector<float> taps(filter_len);
+    liquid_firdes_kaiser(filter_len, fc, STEREO_STOPBAND_DB, 0.0f, taps.data());
+    float sum = 0.0f;
+    for (unsigned int i = 0; i < filter_len; i++) sum += taps[i];
+    for (unsigned int i = 0; i < filter_len; i++) taps[i] /= sum;
+    sum_filter = firdecim_rrrf_create(decim, taps.data(), filter_len);
+    if (stereo) {
+        diff_filter = firdecim_rrrf_create(decim, taps.data(), filter_len);
+    }
+    sum_buf.resize(decim);
+    diff_buf.resize(decim);
+
+    deemph[0].set(deemphasis_us, mid_rate);
+    deemph[1].set(deemphasis_us, mid_rate);
+    blend_step = static_cast<float>(1000.0 / (STEREO_BLEND_MS * mid_rate));
+
+    // Working buffers for the longest block, the intermediate rate is at
+    // least the audio rate so the resampler never expands
+    size_t max_frames = this->max_block / decim + 1;
+    for (int c = 0; c < 2; c++) {
+        resampler[c] = nullptr;
+        if (c < channels()) {
+            chan[c].resize(max_frames);
+            if (std::fabs(mid_rate - audio_rate) > 0.5) {
+                resampler[c] = msresamp_rrrf_create(static_cast<float>(audio_rate / mid_rate), 60.0f);
+                resampled[c].resize(max_frames * 2 + 64);
+            }
+        }
+    }
+    if (rds) {
+        rds_buf.resize(this->max_block);
+    }
+    reset();
+}
+
+WfmStereoDecoder::~WfmStereoDecoder() {
+    firdecim_rrrf_destroy(sum_filter);
+    if (diff_filter) {
+        firdecim_rrrf_destroy(diff_filter);
+    }
+    for (int c = 0; c < 2; c++) {
+        if (resampler[c]) {
+            msresamp_rrrf_destroy(resampler[c]);
+        }
+    }
+}
+
+void WfmStereoDecoder::reset() {
+    phase = 0;
+    freq = freq_nominal;
+    pilot_i = 0.0f;
+    pilot_q = 0.0f;
+    is_locked = false;
+    blend = 0.0f;
+    firdecim_rrrf_reset(sum_filter);
+    if (diff_filter) {
+        firdecim_rrrf_reset(diff_filter);
+    }
+    fill = 0;
+    deemph[0].reset();
+    deemph[1].reset();
+    for (int c = 0; c < 2; c++) {
+        if (resampler[c]) {
+            msresamp_rrrf_reset(resampler[c]);
+        }
+    }
+    locked.store(false, std::memory_order_relaxed);
+    level.store(0.0f, std::memory_order_relaxed);
+}
+
+size_t WfmStereoDecoder::process(const float *mpx, size_t count, float *out, size_t out_size) {
+    size_t written = 0;
+    for (size_t pos = 0; pos < count; pos += max_block) {
+        size_t n = std::min(max_block, count - pos);
+        written += process_block(mpx + pos, n, out + written, out_size - written);
+    }
+    return written;
+}
+
+size_t WfmStereoDecoder::process_block(const float *mpx, size_t count, float *out, size_t out_size) {
+    const float *sine = sine_table();
+    const float to_phase = static_cast<float>(4294967296.0 / (2.0 * M_PI));
+
+    size_t frames = 0;
+    double i_sum = 0.0;
+    double q_sum = 0.0;
+    for (size_t n = 0; n < count; n++) {
+        float x = mpx[n];
+        uint32_t idx = phase >> (32 - SINE_BITS);
+        float s = sine[idx];
+        float c = sine[(idx + SINE_SIZE / 4) & SINE_MASK];
+
+        // Locked when sin(phase) follows the pilot, the quadrature
+        // product is then proportional to the phase error
+        pilot_i += iq_alpha * (x * s - pilot_i);
+        pilot_q += iq_alpha * (x * c - pilot_q);
+        i_sum += pilot_i;
+        q_sum += pilot_q;
+        float amplitude = std::sqrt(pilot_i * pilot_i + pilot_q * pilot_q);
+        float error = pilot_q / std::max(amplitude, PILOT_UNLOCK_LEVEL);
+        freq = std::min(freq_nominal + freq_limit, std::max(freq_nominal - freq_limit, freq + ki * error));
+        phase += static_cast<uint32_t>(static_cast<int64_t>((freq + kp * error) * to_phase));
+
+        sum_buf[fill] = x;
+        if (stereo) {
+            // L-R is double sideband on sin(2 * pilot phase)
+            diff_buf[fill] = 2.0f * x * sine[(idx * 2) & SINE_MASK];
+        }
+        if (rds) {
+            uint32_t idx3 = idx * 3;
+            rds_buf[n] = std::complex<float>(x * sine[(idx3 + SINE_SIZE / 4) & SINE_MASK],
+                                             -x * sine[idx3 & SINE_MASK]);
+        }
+        if (++fill == decim) {
+            firdecim_rrrf_execute(sum_filter, sum_buf.data(), &chan[0][frames]);
+            if (stereo) {
+                firdecim_rrrf_execute(diff_filter, diff_buf.data(), &chan[1][frames]);
+            }
+            fill = 0;
+            frames++;
+        }
+    }
+    if (rds) {
+        rds->process(rds_buf.data(), count);
+    }
+
+    // Lock decided per block from the mean detector outputs
+    if (count > 0) {
+        float mean_i = static_cast<float>(i_sum / count);
+        float mean_q = static_cast<float>(q_sum / count);
+        bool phase_ok = std::fabs(mean_q) < 0.5f * mean_i;
+        is_locked = phase_ok && mean_i > (is_locked ? PILOT_UNLOCK_LEVEL : PILOT_LOCK_LEVEL);
+        locked.store(is_locked, std::memory_order_relaxed);
+        level.store(2.0f * std::max(mean_i, 0.0f), std::memory_order_relaxed);
+    }
+
+    // Matrix with the separation faded in and out, then de-emphasis
+    if (stereo) {
+        float target = is_locked ? 1.0f : 0.0f;
+        for (size_t f = 0; f < frames; f++) {
+            blend += std::max(-blend_step, std::min(blend_step, target - blend));
+            float m = chan[0][f];
+            float d = blend * chan[1][f];
+            chan[0][f] = m + d;
+            chan[1][f] = m - d;
+        }
+    }
+    for (int c = 0; c < channels(); c++) {
+        deemph[c].process(chan[c].data(), frames);
+    }
+
+    // Both channels run through identical resamplers, so they stay aligned
+    const float *src[2] = { chan[0].data(), chan[1].data() };
+    if (resampler[0]) {
+        size_t produced = frames;
+        for (int c = 0; c < channels(); c++) {
+            unsigned int written = 0;
+            msresamp_rrrf_execute(resampler[c], chan[c].data(), static_cast<unsigned int>(frames),
+                                  resampled[c].data(), &written);
+            produced = (c == 0) ? written : std::min<size_t>(produced, written);
+            src[c] = resampled[c].data();
+        }
+        frames = produced;
+    }
+
+    frames = std::min(frames, out_size / channels());
+    if (stereo) {
+        for (size_t f = 0; f < frames; f++) {
+            out[2 * f] = src[0][f];
+            out[2 * f + 1] = src[1][f];
+        }
+    } else {
+        std::copy(src[0], src[0] + frames, out);
+    }
+    return frames * channels();
+}
@@ -0,0 +1,91 @@
+#ifndef _WFM_STEREO_H
+#define _WFM_STEREO_H
+
+#include <atomic>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <liquid/liquid.h>
+#include "fm_demod.h"
+#include "rds.h"
+
+// Broadcast FM multiplex decoder. A PLL locks to the 19 kHz pilot, its
+// doubled phase brings L-R down from 38 kHz and its tripled phase the RDS
+// subcarrier from 57 kHz. L+R and L-R are filtered to 15 kHz and decimated
+// together, so the matrix sees them aligned; without a pilot the output
+// fades to mono. The PLL runs on a sine table and a 32-bit phase
+// accumulator, so the per-sample work is a few multiplies and lookups.
+class WfmStereoDecoder {
+    public:
+        // 'rds' may be null, it is fed but not owned. De-emphasis runs at
+        // the intermediate rate, 0 us leaves the audio flat. Buffers are
+        // sized for blocks of up to 'max_block' samples; longer blocks are
+        // decoded in pieces, so process() never allocates.
+        WfmStereoDecoder(double mpx_rate, int audio_rate, bool stereo, float deemphasis_us, RdsDecoder *rds,
+                         size_t max_block);
+        ~WfmStereoDecoder();
+
+        // Decode 'count' samples of the flat multiplex (1.0 = full
+        // deviation) into interleaved audio at the audio rate, channels()
+        // samples per frame. 'out' may not alias 'mpx'. Returns the
+        // number of samples written.
+        size_t process(const float *mpx, size_t count, float *out, size_t out_size);
+
+        void reset();
+
+        int channels() const { return stereo ? 2 : 1; }
+        double intermediate_rate() const { return mid_rate; }
+        unsigned int taps() const { return filter_len; }
+        bool pilot_locked() const { return locked.load(std::memory_order_relaxed); }
+        // Pilot amplitude relative to full deviation, about 0.08-0.10 on air
+        float pilot_level() const { return level.load(std::memory_order_relaxed); }
+
+    private:
+        WfmStereoDecoder(const WfmStereoDecoder &);
+        WfmStereoDecoder &operator=(const WfmStereoDecoder &);
+
+        size_t process_block(const float *mpx, size_t count, float *out, size_t out_size);
+
+        bool stereo;
+        RdsDecoder *rds;
+        size_t max_block;
+
+        // Pilot PLL
+        uint32_t phase;
+        float freq;                // rad/sample
+        float freq_nominal;
+        float freq_limit;
+        float kp;                  // Proportional and integral loop gains
+        float ki;
+        float iq_alpha;            // Phase detector low-pass
+        float pilot_i;             // In phase, half the pilot amplitude once locked
+        float pilot_q;             // Quadrature, the phase error
+        bool is_locked;
+        float blend;               // 0 = mono, 1 = full separation
+        float blend_step;
+
+        // L+R and L-R to the intermediate rate
+        firdecim_rrrf sum_filter;
+        firdecim_rrrf diff_filter;
+        unsigned int decim;
+        unsigned int filter_len;
+        std::vector<float> sum_buf;
+        std::vector<float> diff_buf;
+        unsigned int fill;
+        double mid_rate;
+
+        Deemphasis deemph[2];
+
+        // Intermediate to audio rate, null when they match
+        msresamp_rrrf resampler[2];
+
+        std::vector<float> chan[2];
+        std::vector<float> resampled[2];
+        std::vector<std::complex<float>> rds_buf;
+
+        std::atomic<bool> locked;
+        std::atomic<float> level;
+};
+
+#endif // _WFM_STEREO_H